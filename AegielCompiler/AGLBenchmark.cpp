@@ -0,0 +1,1856 @@
+//-----------------------------------------------------------
+// Izak De La Cruz
+// AGL compiler micro-benchmarks
+// AGLBenchmark.cpp
+//
+// Stand-alone program (it has its own main(), so it is *NOT* part of the
+//    AegielCompiler project). It includes AGLCompiler.cpp with AGLBENCHMARK
+//    defined, which leaves out the compiler's main() so the scanner, parser,
+//    and code generator can be timed directly. Build it with optimization, for example
+//       cl /O2 /EHsc AGLBenchmark.cpp
+//       g++ -O2 -o AGLBenchmark AGLBenchmark.cpp
+//    and run it from a scratch directory; it writes its own AGLBenchmark.* files
+//    (hundreds of MB) and removes them after each benchmark.
+//    "AGLBenchmark compile" runs only the end-to-end compiler benchmark.
+//-----------------------------------------------------------
+#define AGLBENCHMARK
+#include "AGLCompiler.cpp"
+
+#include <algorithm>
+#include <new>
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+const char BENCHMARKFILENAME[] = "AGLBenchmark";
+
+//-----------------------------------------------------------
+// Every allocation the program makes is counted (the compiler benchmark reports them)
+//-----------------------------------------------------------
+atomic<long long> allocationCount(0);
+atomic<long long> allocatedBytes(0);
+
+void* operator new(size_t size)
+{
+    void* p = malloc((size == 0) ? 1 : size);
+
+    if (p == NULL) throw(bad_alloc());
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add((long long)size, memory_order_relaxed);
+    return(p);
+}
+
+void* operator new[](size_t size)
+{
+    return(operator new(size));
+}
+
+// (kept out of line, or GCC sees free() inlined into the delete of a new-expression and warns)
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+//-----------------------------------------------------------
+void RemoveBenchmarkFiles()
+//-----------------------------------------------------------
+{
+    // The source, listing, and STM code files the benchmarks write under BENCHMARKFILENAME
+    const char EXTENSIONS[][5 + 1] = { ".agl", ".list", ".stm" };
+    char fullFileName[80 + 1];
+
+    for (int i = 0; i <= (int)(sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0])) - 1; i++)
+    {
+        sprintf(fullFileName, "%s%s", BENCHMARKFILENAME, EXTENSIONS[i]);
+        remove(fullFileName);
+    }
+}
+
+//-----------------------------------------------------------
+double SecondsSince(chrono::steady_clock::time_point start)
+//-----------------------------------------------------------
+{
+    return(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+}
+
+//-----------------------------------------------------------
+void ReportResult(const char description[], double seconds, double baselineSeconds, long long count)
+//-----------------------------------------------------------
+{
+    char information[SOURCELINELENGTH + 1];
+
+    sprintf(information, "   %-44s %9.3f ms  %6.2fx  (count = %lld)",
+        description, seconds * 1000.0, baselineSeconds / seconds, count);
+    cout << information << endl;
+}
+
+//-----------------------------------------------------------
+void ReportThroughput(const char description[], double seconds, long long bytes, long long count)
+//-----------------------------------------------------------
+{
+    char information[SOURCELINELENGTH + 1];
+
+    sprintf(information, "   %-44s %9.3f ms  %7.1f MB/s  (count = %lld)",
+        description, seconds * 1000.0, (bytes / (1024.0 * 1024.0)) / seconds, count);
+    cout << information << endl;
+}
+
+//-----------------------------------------------------------
+void ReportCostPerOperation(const char description[], double seconds, long long count)
+//-----------------------------------------------------------
+{
+    char information[SOURCELINELENGTH + 1];
+
+    sprintf(information, "   %-44s %9.3f ms  %7.1f ns each  (count = %lld)",
+        description, seconds * 1000.0, seconds * 1.0e9 / count, count);
+    cout << information << endl;
+}
+
+//-----------------------------------------------------------
+void WriteLongLineSource(int lines, int lineLength)
+//-----------------------------------------------------------
+{
+    /*
+       Lines of identifiers and integers near SOURCELINELENGTH characters long,
+          typical of machine-generated AGL
+    */
+    char fullFileName[80 + 1];
+    ofstream SOURCE;
+
+    sprintf(fullFileName, "%s.agl", BENCHMARKFILENAME);
+    SOURCE.open(fullFileName, ios::out);
+    for (int i = 1; i <= lines; i++)
+    {
+        string line = "   ";
+
+        while ((int)line.size() < lineLength - 16)
+        {
+            char word[48 + 1];
+
+            sprintf(word, "identifier_%d %d ", (int)line.size(), i);
+            line += word;
+        }
+        SOURCE << line << "\n";
+    }
+    SOURCE.close();
+}
+
+//-----------------------------------------------------------
+inline bool IsWordCharacter(char c)
+//-----------------------------------------------------------
+{
+    return(isalpha(c) || isdigit(c) || (c == '_'));
+}
+
+//-----------------------------------------------------------
+long long ScanLinesWithStrlen(const vector<string>& sourceLines)
+//-----------------------------------------------------------
+{
+    /*
+       Reproduces the original READER::GetNextCharacter() end-of-line test, which
+          evaluated strlen(sourceLine) for every character (volatile keeps the
+          optimizer from hoisting strlen() out of the loop, as it could not in READER)
+    */
+    long long words = 0;
+
+    for (size_t l = 0; l < sourceLines.size(); l++)
+    {
+        const char* volatile sourceLine = sourceLines[l].c_str();
+        bool inWord = false;
+
+        for (int sourceLineIndex = 0; sourceLineIndex <= ((int)strlen(sourceLine) - 1); sourceLineIndex++)
+        {
+            bool isWordCharacter = IsWordCharacter(sourceLine[sourceLineIndex]);
+
+            if (isWordCharacter && !inWord) words++;
+            inWord = isWordCharacter;
+        }
+    }
+    return(words);
+}
+
+//-----------------------------------------------------------
+long long ScanLinesWithLength(const vector<string>& sourceLines)
+//-----------------------------------------------------------
+{
+    // Same scan using an explicit source line length (READER::sourceLineLength)
+    long long words = 0;
+
+    for (size_t l = 0; l < sourceLines.size(); l++)
+    {
+        const char* sourceLine = sourceLines[l].c_str();
+        const int sourceLineLength = (int)sourceLines[l].size();
+        bool inWord = false;
+
+        for (int sourceLineIndex = 0; sourceLineIndex <= sourceLineLength - 1; sourceLineIndex++)
+        {
+            bool isWordCharacter = IsWordCharacter(sourceLine[sourceLineIndex]);
+
+            if (isWordCharacter && !inWord) words++;
+            inWord = isWordCharacter;
+        }
+    }
+    return(words);
+}
+
+//-----------------------------------------------------------
+long long ScanWithGetNextCharacter(READER<0, LOOKAHEAD>& reader)
+//-----------------------------------------------------------
+{
+    long long words = 0;
+    bool inWord = false;
+    char nextCharacter = reader.GetLookAheadCharacter(0).character;
+
+    while (nextCharacter != READER<0, LOOKAHEAD>::EOPC)
+    {
+        bool isWordCharacter = IsWordCharacter(nextCharacter);
+
+        if (isWordCharacter && !inWord) words++;
+        inWord = isWordCharacter;
+        nextCharacter = reader.GetNextCharacter().character;
+    }
+    return(words);
+}
+
+//-----------------------------------------------------------
+long long ScanWithCharacterSpans(READER<0, LOOKAHEAD>& reader)
+//-----------------------------------------------------------
+{
+    long long words = 0;
+    bool inWord = false;
+    char nextCharacter = reader.GetLookAheadCharacter(0).character;
+
+    while (nextCharacter != READER<0, LOOKAHEAD>::EOPC)
+    {
+        const char* span;
+        int n = reader.GetCharacterSpan(span);
+
+        if (n == 0)
+        {
+            bool isWordCharacter = IsWordCharacter(nextCharacter);
+
+            if (isWordCharacter && !inWord) words++;
+            inWord = isWordCharacter;
+            nextCharacter = reader.GetNextCharacter().character;
+        }
+        else
+        {
+            for (int j = 0; j <= n - 1; j++)
+            {
+                bool isWordCharacter = IsWordCharacter(span[j]);
+
+                if (isWordCharacter && !inWord) words++;
+                inWord = isWordCharacter;
+            }
+            nextCharacter = reader.SkipCharacters(n).character;
+        }
+    }
+    return(words);
+}
+
+//-----------------------------------------------------------
+void BenchmarkLongLineReader(int lines)
+//-----------------------------------------------------------
+{
+    vector<string> sourceLines;
+    LISTER lister(LINESPERPAGE);
+    double baselineSeconds;
+
+    WriteLongLineSource(lines, SOURCELINELENGTH);
+    lister.OpenFile(BENCHMARKFILENAME);
+
+    {
+        char fullFileName[80 + 1];
+        char line[SOURCELINELENGTH + 2];
+        ifstream SOURCE;
+
+        sprintf(fullFileName, "%s.agl", BENCHMARKFILENAME);
+        SOURCE.open(fullFileName, ios::in);
+        while (SOURCE.getline(line, sizeof(line)))
+            sourceLines.push_back(line);
+    }
+
+    cout << "End-of-line test (" << lines << " in-memory lines of ~" << SOURCELINELENGTH << " characters)" << endl;
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long words = ScanLinesWithStrlen(sourceLines);
+
+        baselineSeconds = SecondsSince(start);
+        ReportResult("strlen() per character (original)", baselineSeconds, baselineSeconds, words);
+    }
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long words = ScanLinesWithLength(sourceLines);
+
+        ReportResult("explicit source line length", SecondsSince(start), baselineSeconds, words);
+    }
+
+    cout << "READER scan (" << lines << " source lines of ~" << SOURCELINELENGTH << " characters, includes listing)" << endl;
+    for (int mapped = 0; mapped <= 1; mapped++)
+    {
+        {
+            READER<0, LOOKAHEAD> reader(SOURCELINELENGTH);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+            reader.SetLister(&lister);
+            reader.SetMappedSourceON(mapped == 1);
+            reader.OpenFile(BENCHMARKFILENAME);
+            long long words = ScanWithGetNextCharacter(reader);
+            double seconds = SecondsSince(start);
+
+            if (mapped == 0) baselineSeconds = seconds;
+            ReportResult(mapped ? "GetNextCharacter(), mapped source" : "GetNextCharacter(), stream source",
+                seconds, baselineSeconds, words);
+        }
+        {
+            READER<0, LOOKAHEAD> reader(SOURCELINELENGTH);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+            reader.SetLister(&lister);
+            reader.SetMappedSourceON(mapped == 1);
+            reader.OpenFile(BENCHMARKFILENAME);
+            long long words = ScanWithCharacterSpans(reader);
+            ReportResult(mapped ? "GetCharacterSpan(), mapped source" : "GetCharacterSpan(), stream source",
+                SecondsSince(start), baselineSeconds, words);
+        }
+    }
+}
+
+//===========================================================
+class ENDLLISTER
+    //===========================================================
+{
+    // The original LISTER output path (every line ends with endl) for comparison
+private:
+    const int LINESPERPAGE;
+
+    ofstream LIST;
+    int pageNumber;
+    int linesOnPage;
+
+public:
+    ENDLLISTER(const int LINESPERPAGE, const char fullFileName[]) : LINESPERPAGE(LINESPERPAGE)
+    {
+        pageNumber = 0;
+        linesOnPage = 0;
+        LIST.open(fullFileName, ios::out);
+        ListTopOfPageHeader();
+    }
+    void ListSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength)
+    {
+        if (linesOnPage >= LINESPERPAGE)
+        {
+            ListTopOfPageHeader();
+            linesOnPage = 0;
+        }
+        LIST << setw(4) << sourceLineNumber << " ";
+        LIST.write(sourceLine, sourceLineLength);
+        LIST << endl;
+        linesOnPage++;
+    }
+    void ListInformationLine(const char information[])
+    {
+        if (linesOnPage >= LINESPERPAGE)
+        {
+            ListTopOfPageHeader();
+            linesOnPage = 0;
+        }
+        LIST << information << endl;
+        linesOnPage++;
+    }
+
+private:
+    void ListTopOfPageHeader()
+    {
+        const char FF = 0X0C;
+
+        pageNumber++;
+        LIST << FF << '"' << "AGLBenchmark.agl" << "\" Page " << setw(4) << pageNumber << endl;
+        LIST << "Line Source Line" << endl;
+        LIST << "---- -------------------------------------------------------------------------------" << endl;
+    }
+};
+
+//-----------------------------------------------------------
+template <typename LISTERTYPE>
+long long ListLines(LISTERTYPE& lister, int lines)
+//-----------------------------------------------------------
+{
+    // Typical listing mix: source lines with an information (trace) line every 4th line
+    const char sourceLine[] = "   ORDAIN MUTABLE counter : INTEGER <- counter + 1;   // typical source line";
+    const int sourceLineLength = (int)strlen(sourceLine);
+    long long listed = 0;
+
+    for (int i = 1; i <= lines; i++)
+    {
+        lister.ListSourceLine(i, sourceLine, sourceLineLength);
+        listed++;
+        if (i % 4 == 0)
+        {
+            lister.ListInformationLine("Found identifier \"counter\" at index = 1 (is in current scope)");
+            listed++;
+        }
+    }
+    return(listed);
+}
+
+//-----------------------------------------------------------
+void BenchmarkLister(int lines)
+//-----------------------------------------------------------
+{
+    double baselineSeconds;
+
+    cout << "LISTER throughput (" << lines << " source lines plus information lines)" << endl;
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long listed;
+
+        {
+            ENDLLISTER lister(LINESPERPAGE, "AGLBenchmark.list");
+
+            listed = ListLines(lister, lines);
+        }
+        baselineSeconds = SecondsSince(start);
+        ReportResult("endl per line (original)", baselineSeconds, baselineSeconds, listed);
+    }
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long listed;
+
+        {
+            LISTER lister(LINESPERPAGE);
+
+            lister.OpenFile(BENCHMARKFILENAME);
+            listed = ListLines(lister, lines);
+        }
+        ReportResult("buffered, flushed at page boundaries", SecondsSince(start), baselineSeconds, listed);
+    }
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long listed;
+
+        {
+            LISTER lister(LINESPERPAGE);
+
+            lister.SetBackgroundWriterON();
+            lister.OpenFile(BENCHMARKFILENAME);
+            listed = ListLines(lister, lines);
+        }
+        ReportResult("background writer thread", SecondsSince(start), baselineSeconds, listed);
+    }
+}
+
+//-----------------------------------------------------------
+template <typename KERNEL>
+long long SumRuns(const vector<string>& sourceLines, KERNEL RunLength)
+//-----------------------------------------------------------
+{
+    // One run from the beginning of each line, as the scanner skips indentation, an identifier, or a comment
+    long long sum = 0;
+
+    for (size_t l = 0; l < sourceLines.size(); l++)
+        sum += RunLength(sourceLines[l].c_str(), (int)sourceLines[l].size());
+    return(sum);
+}
+
+//-----------------------------------------------------------
+void BenchmarkCharacterRuns(int lines)
+//-----------------------------------------------------------
+{
+    // Code generator style lines: deep indentation, long identifiers, and long // comments
+    vector<string> indentationLines;
+    vector<string> identifierLines;
+    vector<string> commentLines;
+
+    for (int i = 1; i <= lines; i++)
+    {
+        char line[SOURCELINELENGTH + 1];
+
+        sprintf(line, "%*s// generated from template %d; do not edit this line by hand, regenerate it instead", 4 * (i % 24) + 8, "", i);
+        indentationLines.push_back(line);
+        commentLines.push_back(line + 4 * (i % 24) + 10);
+        sprintf(line, "generated_identifier_%d_of_the_template_module_%d_counter", i, i % 97);
+        identifierLines.push_back(line);
+    }
+
+#if defined(SIMDAVX2)
+    cout << "Character-run kernels (" << lines << " lines each, AVX2 versus scalar)" << endl;
+#elif defined(SIMDSSE2)
+    cout << "Character-run kernels (" << lines << " lines each, SSE2 versus scalar)" << endl;
+#else
+    cout << "Character-run kernels (" << lines << " lines each, scalar only)" << endl;
+#endif
+    for (int kernel = 1; kernel <= 3; kernel++)
+    {
+        const vector<string>& sourceLines = (kernel == 1) ? indentationLines : ((kernel == 2) ? identifierLines : commentLines);
+        double baselineSeconds;
+        long long sum;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (int pass = 1; pass <= 50; pass++)
+        {
+            if (kernel == 1)
+                sum = SumRuns(sourceLines, CHARACTERRUNS::ScalarSpaceRunLength);
+            else if (kernel == 2)
+                sum = SumRuns(sourceLines, CHARACTERRUNS::ScalarIdentifierRunLength);
+            else
+                sum = SumRuns(sourceLines, [](const char span[], int n) { int j = 0; while ((j < n) && (span[j] != '\0')) j++; return(j); });
+        }
+        baselineSeconds = SecondsSince(start);
+        ReportResult((kernel == 1) ? "spaces/tabs, scalar" : ((kernel == 2) ? "identifier, scalar" : "comment end, character loop"),
+            baselineSeconds, baselineSeconds, sum);
+
+        start = chrono::steady_clock::now();
+        for (int pass = 1; pass <= 50; pass++)
+        {
+            if (kernel == 1)
+                sum = SumRuns(sourceLines, CHARACTERRUNS::SpaceRunLength);
+            else if (kernel == 2)
+                sum = SumRuns(sourceLines, CHARACTERRUNS::IdentifierRunLength);
+            else
+                sum = SumRuns(sourceLines, [](const char span[], int n) { return(CHARACTERRUNS::FindCharacter(span, n, '\0')); });
+        }
+        ReportResult((kernel == 1) ? "spaces/tabs, CHARACTERRUNS" : ((kernel == 2) ? "identifier, CHARACTERRUNS" : "comment end, FindCharacter() (memchr())"),
+            SecondsSince(start), baselineSeconds, sum);
+    }
+}
+
+//-----------------------------------------------------------
+long long WriteScannerSource(int copies)
+//-----------------------------------------------------------
+{
+    // Every kind of token, comments, and white space; returns the size of the source file
+    const char PROGRAM[] =
+        "// Scanner benchmark program\n"
+        "ORDAIN x : INTEGER <- 5, MUTABLE y : INTEGER <- (3 + 4);\n"
+        "ORDAIN MUTABLE flag : TESTAMENT <- TRUTH;   // trailing comment\n"
+        "MAIN\n"
+        "{\n"
+        "   ORDAIN MUTABLE counter_1 : integer <- 0;\n"
+        "\tOUTPUT(\"Hello, \\\"world\\\"\\n\", ENDL, x, ENDL);\n"
+        "   y <- y + x ** 2 - counter_1 / 3 % 2 ^ 1;\n"
+        "   DECREE (x < y) THEN { OUTPUT(\"lt\", ENDL); }\n"
+        "   LEST (x <= y AND flag) THEN { OUTPUT(\"le\", ENDL); }\n"
+        "   LEST (x != y OR x = y XOR flag NOR flag NAND INVERT flag) THEN { OUTPUT(\"ne\"); }\n"
+        "   OTHERWISE { OUTPUT(\"ge\", ENDL); } CONCLUDED;\n"
+        "   VIGIL { counter_1 <- counter_1 + 1; } UNTIL (counter_1 >= 10) { OUTPUT(counter_1, ENDL); } CONCLUDED;\n"
+        "   WHILST (counter_1 > 0) MAINTAIN { counter_1 <- counter_1 - 1; } CONCLUDED;\n"
+        "}\n";
+    char fullFileName[80 + 1];
+    ofstream SOURCE;
+
+    sprintf(fullFileName, "%s.agl", BENCHMARKFILENAME);
+    SOURCE.open(fullFileName, ios::out | ios::binary);
+    for (int i = 1; i <= copies; i++)
+        SOURCE << PROGRAM;
+    SOURCE << "END\n";
+    SOURCE.close();
+    return((long long)copies * (long long)strlen(PROGRAM) + 4);
+}
+
+//-----------------------------------------------------------
+void BenchmarkScanner(int copies)
+//-----------------------------------------------------------
+{
+    /*
+       GetNextToken() works on the compiler's global reader and lister, so it can
+          only be timed once per run. The listing-on-error lister does no listing
+          I/O, which leaves the scanner and READER.
+    */
+    long long bytes = WriteScannerSource(copies);
+
+    cout << "Scanner throughput (" << bytes / (1024 * 1024) << " MB of source, mapped source reader)" << endl;
+    {
+        READER<0, LOOKAHEAD> reader(SOURCELINELENGTH);
+        LISTER lister(LINESPERPAGE);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        lister.SetListingOnErrorON();
+        lister.OpenFile(BENCHMARKFILENAME);
+        reader.SetLister(&lister);
+        reader.SetMappedSourceON();
+        reader.OpenFile(BENCHMARKFILENAME);
+        long long words = ScanWithCharacterSpans(reader);
+        ReportThroughput("READER only (GetCharacterSpan())", SecondsSince(start), bytes, words);
+    }
+    {
+        TOKENBUFFER tokenBuffer;
+        TOKENCURSOR tokens;
+        long long count = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        lister.SetListingOnErrorON();
+        lister.OpenFile(BENCHMARKFILENAME);
+        reader.SetLister(&lister);
+        reader.SetMappedSourceON();
+        reader.OpenFile(BENCHMARKFILENAME);
+        ScanSource(tokenBuffer);
+        ReportThroughput("ScanSource() into a TOKENBUFFER", SecondsSince(start), bytes, tokenBuffer.GetCount());
+
+        // What the parser pays per token once the source is pre-tokenized
+        start = chrono::steady_clock::now();
+        tokens.SetTokenBuffer(&tokenBuffer);
+        for (int i = 0; i <= tokenBuffer.GetCount() - 1; i++)
+        {
+            count += tokens[0].type + tokens[LOOKAHEAD].lexeme.size();
+            tokens.Advance();
+        }
+        ReportThroughput("TOKENCURSOR walk (tokens[0], tokens[LOOKAHEAD])", SecondsSince(start), bytes, count);
+    }
+    {
+        // A second READER stands in for the global one, which has already been scanned
+        READER<CALLBACKSUSED, LOOKAHEAD> sourceReader(SOURCELINELENGTH);
+        TOKENBUFFER tokenBuffer;
+        char description[80 + 1];
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        lister.OpenFile(BENCHMARKFILENAME);
+        sourceReader.SetLister(&lister);
+        sourceReader.SetMappedSourceON();
+        sourceReader.OpenFile(BENCHMARKFILENAME);
+        scanContext.reader = &sourceReader;
+        scanContext.EOPTOKENs = 0;
+        ScanSourceInParallel(tokenBuffer, BENCHMARKFILENAME, 1024 * 1024);
+
+        sprintf(description, "ScanSourceInParallel() (%u hardware threads)", max(thread::hardware_concurrency(), 1U));
+        ReportThroughput(description, SecondsSince(start), bytes, tokenBuffer.GetCount());
+    }
+}
+
+//-----------------------------------------------------------
+void BenchmarkIdentifierTable(int identifiers)
+//-----------------------------------------------------------
+{
+    /*
+       identifiers global identifiers, then as many again in a nested scope, each
+          shadowing a global. GetIndex() is also timed with its trace category ON,
+          which logs one TRACEEVENT per call.
+    */
+    LISTER lister(LINESPERPAGE);
+    TRACER tracer;
+    IDENTIFIERINTERNER interner;
+    IDENTIFIERTABLE identifierTable(&lister, &interner, INITIALIDENTIFIERS);
+    vector<int> symbols(identifiers);
+    char lexeme[MAXIMUMLENGTHIDENTIFIER + 1], reference[MAXIMUMLENGTHIDENTIFIER + 1];
+    long long count = 0;
+    bool isInTable;
+    chrono::steady_clock::time_point start;
+
+    lister.SetListingOnErrorON();
+    lister.OpenFile(BENCHMARKFILENAME);
+    cout << "Identifier table (" << identifiers << " identifiers)" << endl;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i <= identifiers - 1; i++)
+    {
+        sprintf(lexeme, "Identifier_%d", i);
+        symbols[i] = interner.Intern(lexeme, (int)strlen(lexeme));
+    }
+    ReportCostPerOperation("IDENTIFIERINTERNER::Intern()", SecondsSince(start), identifiers);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i <= identifiers - 1; i++)
+    {
+        sprintf(reference, "SB:0D%d", i);
+        identifierTable.AddToTable(symbols[i], GLOBAL_VARIABLE, INTTYPE, reference);
+    }
+    ReportCostPerOperation("AddToTable() (global scope)", SecondsSince(start), identifiers);
+
+    // Look up in a scattered order (7919 is prime) so lookups do not follow insertion order
+    start = chrono::steady_clock::now();
+    for (int i = 0; i <= identifiers - 1; i++)
+        count += identifierTable.GetIndex(symbols[(int)(((long long)i * 7919) % identifiers)], isInTable);
+    ReportCostPerOperation("GetIndex()", SecondsSince(start), identifiers);
+
+    identifierTable.SetTracer(&tracer);
+    tracer.SetCategoriesON(TRACER::IDENTIFIERTABLETRACE);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i <= identifiers - 1; i++)
+        count += identifierTable.GetIndex(symbols[(int)(((long long)i * 7919) % identifiers)], isInTable);
+    ReportCostPerOperation("GetIndex() (IDENTIFIERTABLE trace ON)", SecondsSince(start), identifiers);
+    tracer.SetCategoriesON(TRACER::IDENTIFIERTABLETRACE, false);
+
+    // The time report pays for two clock reads per lookup
+    STATISTICS lookupStatistics;
+
+    lookupStatistics.SetON();
+    identifierTable.SetStatistics(&lookupStatistics);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i <= identifiers - 1; i++)
+        count += identifierTable.GetIndex(symbols[(int)(((long long)i * 7919) % identifiers)], isInTable);
+    ReportCostPerOperation("GetIndex() (time report ON)", SecondsSince(start), identifiers);
+    identifierTable.SetStatistics(NULL);
+
+    start = chrono::steady_clock::now();
+    identifierTable.EnterNestedStaticScope();
+    for (int i = 0; i <= identifiers - 1; i++)
+    {
+        sprintf(reference, "SB:0D%d", identifiers + i);
+        identifierTable.AddToTable(symbols[i], PROGRAMMODULE_VARIABLE, INTTYPE, reference);
+    }
+    ReportCostPerOperation("AddToTable() (nested scope, shadowing)", SecondsSince(start), identifiers);
+
+    char description[80 + 1];
+
+    sprintf(description, "Memory: %.1f MB table + %.1f MB interner",
+        identifierTable.GetBytesAllocated() / (1024.0 * 1024.0), interner.GetBytesAllocated() / (1024.0 * 1024.0));
+    cout << "   " << description << " = "
+        << (identifierTable.GetBytesAllocated() + interner.GetBytesAllocated()) / (2 * identifiers)
+        << " bytes per identifier" << endl;
+
+    start = chrono::steady_clock::now();
+    identifierTable.ExitNestedStaticScope();
+    ReportCostPerOperation("ExitNestedStaticScope()", SecondsSince(start), identifiers);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i <= identifiers - 1; i++)
+        count += identifierTable.GetIndex(symbols[i], isInTable);
+    ReportCostPerOperation("GetIndex() (after scope exit)", SecondsSince(start), identifiers);
+    cout << "   (sum of indexes found = " << count << ")" << endl;
+}
+
+//-----------------------------------------------------------
+struct STMLINE
+//-----------------------------------------------------------
+{
+    const char* label;
+    const char* mnemonic;
+    const char* operand;
+    const char* comment;
+};
+
+//-----------------------------------------------------------
+void WriteSTMLineWithEndl(ofstream& STM, const char label[], const char mnemonic[], const char operand[], const char comment[])
+//-----------------------------------------------------------
+{
+    // The original CODE::EmitFormattedLine() output path (sprintf() and endl per line) for comparison
+    char line[110 + 1];
+
+    if ((int)strlen(comment) > 0)
+        sprintf(line, "%-22s %-9s %-20s ; %s", label, mnemonic, operand, comment);
+    else
+        sprintf(line, "%-22s %-9s %s", label, mnemonic, operand);
+    STM << line << endl;
+}
+
+//-----------------------------------------------------------
+void BenchmarkSTMWriter(int instructions)
+//-----------------------------------------------------------
+{
+    /*
+       The instruction mix of a typical assignment, expression, and DECREE,
+          with a few labels and comments. CODE is flushed every FLUSHEVERY
+          instructions (as a compiler pass with bounded memory would do).
+    */
+    const int FLUSHEVERY = 100000;
+    const STMLINE MIX[] =
+    {
+        { "", "PUSH", "SB:0D12", "x" },
+        { "", "PUSH", "#0D1", "" },
+        { "", "ADDI", "", "" },
+        { "", "POP", "SB:0D13", "y" },
+        { "", "PUSH", "FB:0D-4", "" },
+        { "", "CMPI", "", "" },
+        { "", "JMPL", "SB0003", "" },
+        { "", "MAKEDUP", "", "" },
+        { "", "POP", "@SP:0D2", "" },
+        { "", "SWAP", "", "" },
+        { "", "DISCARD", "#0D1", "" },
+        { "SB0003", "EQU", "*", "" },
+        { "", "PUSHA", "SB:0D7", "\"Hello\"" },
+        { "", "SVC", "#SVC_WRITE_STRING", "" },
+        { "", "JMP", "SB0004", "" },
+        { "SB0004", "EQU", "*", "end DECREE" }
+    };
+    const int MIXSIZE = (int)(sizeof(MIX) / sizeof(MIX[0]));
+    double baselineSeconds;
+    char description[80 + 1];
+
+    cout << "STM code writer (" << instructions << " instructions)" << endl;
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        {
+            ofstream STM("AGLBenchmark.stm", ios::out);
+
+            for (int i = 0; i <= instructions - 1; i++)
+            {
+                const STMLINE& line = MIX[i % MIXSIZE];
+
+                WriteSTMLineWithEndl(STM, line.label, line.mnemonic, line.operand, line.comment);
+            }
+        }
+        baselineSeconds = SecondsSince(start);
+        ReportResult("sprintf() and endl per line (original)", baselineSeconds, baselineSeconds, instructions);
+    }
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now(), flushStart;
+        double flushSeconds = 0.0;
+        long long bytes;
+
+        {
+            CODE code;
+
+            code.OpenFile(BENCHMARKFILENAME);
+            for (int i = 0; i <= instructions - 1; i++)
+            {
+                const STMLINE& line = MIX[i % MIXSIZE];
+
+                code.EmitFormattedLine(line.label, line.mnemonic, line.operand, line.comment);
+                if ((i + 1) % FLUSHEVERY == 0)
+                {
+                    flushStart = chrono::steady_clock::now();
+                    code.Flush();
+                    flushSeconds += SecondsSince(flushStart);
+                }
+            }
+            flushStart = chrono::steady_clock::now();
+            code.Flush();
+            flushSeconds += SecondsSince(flushStart);
+            bytes = code.GetBytesWritten();
+        }
+        ReportResult("EmitFormattedLine() + buffered column writer", SecondsSince(start), baselineSeconds, instructions);
+        sprintf(description, "of which Flush() (every %d)", FLUSHEVERY);
+        ReportThroughput(description, flushSeconds, bytes, instructions);
+    }
+}
+
+//===========================================================
+// End-to-end compiler benchmark over synthetic AGL workloads
+//===========================================================
+/*
+   Each compile runs in a fork()ed child process so it starts from the same pristine
+      global reader, lister, code, and identifierTable, and so its peak RSS is its
+      own. The generated programs are deterministic, which (with the median of
+      several compiles) keeps results stable enough to compare across releases.
+      Under _WIN32 (no fork()) only the first compile of a run can be measured.
+*/
+struct WORKLOAD
+{
+    const char* name;
+    int globals;               // ORDAIN INTEGER globals (and globals/8 + 1 TESTAMENT globals)
+    int blocks;                // MAIN body blocks, each with one of everything below
+    int chainLength;           // DECREE, chainLength - 1 LESTs, OTHERWISE
+    int loopDepth;             // nested WHILST/VIGIL/PERSIST loops
+    int expressionTerms;       // terms in each long expression
+};
+
+struct COMPILESAMPLE
+{
+    bool isCompiled;
+    double seconds;
+    double phaseSeconds[STATISTICS::PHASES];   // only when the time report is ON
+    long long tokens;                          // only when the time report is ON
+    long long peakRSS;                         // bytes
+    long long allocations;
+    long long bytesAllocated;
+};
+
+//-----------------------------------------------------------
+void WriteSourceLine(ofstream& SOURCE, int depth, const char text[], long long& lines)
+//-----------------------------------------------------------
+{
+    for (int i = 1; i <= depth; i++)
+        SOURCE << "   ";
+    SOURCE << text << "\n";
+    lines++;
+}
+
+//-----------------------------------------------------------
+void WriteLoopNest(ofstream& SOURCE, const WORKLOAD& workload, int block, int depth, int nesting, long long& lines)
+//-----------------------------------------------------------
+{
+    // The loops cycle WHILST, VIGIL, PERSIST from the outermost in
+    char line[SOURCELINELENGTH + 1];
+
+    if (nesting == workload.loopDepth)
+    {
+        sprintf(line, "s <- s + g%d - i;", (block + nesting) % workload.globals);
+        WriteSourceLine(SOURCE, depth, line, lines);
+        return;
+    }
+    switch (nesting % 3)
+    {
+    case 0:
+        sprintf(line, "WHILST (i > %d) MAINTAIN", nesting);
+        WriteSourceLine(SOURCE, depth, line, lines);
+        WriteSourceLine(SOURCE, depth, "{", lines);
+        WriteLoopNest(SOURCE, workload, block, depth + 1, nesting + 1, lines);
+        WriteSourceLine(SOURCE, depth, "} CONCLUDED;", lines);
+        break;
+    case 1:
+        WriteSourceLine(SOURCE, depth, "VIGIL", lines);
+        WriteSourceLine(SOURCE, depth, "{", lines);
+        WriteLoopNest(SOURCE, workload, block, depth + 1, nesting + 1, lines);
+        sprintf(line, "} UNTIL (i >= %d)", 10 + nesting);
+        WriteSourceLine(SOURCE, depth, line, lines);
+        WriteSourceLine(SOURCE, depth, "{", lines);
+        WriteSourceLine(SOURCE, depth + 1, "i <- i + 1;", lines);
+        WriteSourceLine(SOURCE, depth, "} CONCLUDED;", lines);
+        break;
+    case 2:
+        WriteSourceLine(SOURCE, depth, "PERSIST", lines);
+        WriteSourceLine(SOURCE, depth, "{", lines);
+        WriteLoopNest(SOURCE, workload, block, depth + 1, nesting + 1, lines);
+        sprintf(line, "} WHILST (i < %d) CONCLUDED;", 3 + nesting);
+        WriteSourceLine(SOURCE, depth, line, lines);
+        break;
+    }
+}
+
+//-----------------------------------------------------------
+long long WriteSyntheticSource(const WORKLOAD& workload, long long& bytes)
+//-----------------------------------------------------------
+{
+    // Writes BENCHMARKFILENAME.agl; returns its number of lines
+    const int flags = workload.globals / 8 + 1;
+    char fullFileName[80 + 1];
+    char line[SOURCELINELENGTH + 1];
+    ofstream SOURCE;
+    long long lines = 0;
+
+    sprintf(fullFileName, "%s.agl", BENCHMARKFILENAME);
+    SOURCE.open(fullFileName, ios::out | ios::binary);
+    sprintf(line, "// Synthetic AGL workload \"%s\"", workload.name);
+    WriteSourceLine(SOURCE, 0, line, lines);
+    for (int i = 0; i <= workload.globals - 1; i++)
+    {
+        sprintf(line, "ORDAIN MUTABLE g%d : INTEGER <- %d;", i, i);
+        WriteSourceLine(SOURCE, 0, line, lines);
+    }
+    for (int i = 0; i <= flags - 1; i++)
+    {
+        sprintf(line, "ORDAIN MUTABLE flag%d : TESTAMENT <- %s;", i, ((i % 2 == 0) ? "TRUTH" : "FALSEHOOD"));
+        WriteSourceLine(SOURCE, 0, line, lines);
+    }
+    WriteSourceLine(SOURCE, 0, "MAIN", lines);
+    WriteSourceLine(SOURCE, 0, "{", lines);
+    WriteSourceLine(SOURCE, 1, "ORDAIN MUTABLE i : INTEGER <- 0;", lines);
+    WriteSourceLine(SOURCE, 1, "ORDAIN MUTABLE s : INTEGER <- 0;", lines);
+    for (int block = 0; block <= workload.blocks - 1; block++)
+    {
+        const int a = block % workload.globals;
+        const int b = (block * 7 + 1) % workload.globals;
+
+        // DECREE/LEST chain
+        sprintf(line, "DECREE (g%d < g%d) THEN", a, b);
+        WriteSourceLine(SOURCE, 1, line, lines);
+        WriteSourceLine(SOURCE, 1, "{", lines);
+        WriteSourceLine(SOURCE, 2, "s <- s + 1;", lines);
+        WriteSourceLine(SOURCE, 1, "}", lines);
+        for (int k = 1; k <= workload.chainLength - 1; k++)
+        {
+            sprintf(line, "LEST ((g%d = %d) OR (g%d <= s AND flag%d)) THEN", a, k, b, (block + k) % flags);
+            WriteSourceLine(SOURCE, 1, line, lines);
+            WriteSourceLine(SOURCE, 1, "{", lines);
+            sprintf(line, "s <- s - %d;", k);
+            WriteSourceLine(SOURCE, 2, line, lines);
+            WriteSourceLine(SOURCE, 1, "}", lines);
+        }
+        WriteSourceLine(SOURCE, 1, "OTHERWISE", lines);
+        WriteSourceLine(SOURCE, 1, "{", lines);
+        WriteSourceLine(SOURCE, 2, "OUTPUT(\"block \", s, ENDL);", lines);
+        WriteSourceLine(SOURCE, 1, "}", lines);
+        WriteSourceLine(SOURCE, 1, "CONCLUDED;", lines);
+
+        // Nested loops
+        WriteLoopNest(SOURCE, workload, block, 1, 0, lines);
+
+        // Long expression
+        string expression = "s <- s";
+
+        for (int k = 1; k <= workload.expressionTerms; k++)
+        {
+            const int g = (block + k * 13) % workload.globals;
+
+            switch (k % 4)
+            {
+            case 0: sprintf(line, " + g%d", g); break;
+            case 1: sprintf(line, " - g%d * %d", g, k); break;
+            case 2: sprintf(line, " + (g%d + %d) / %d", g, k, 1 + k % 7); break;
+            case 3: sprintf(line, " - g%d %% %d", g, 2 + k % 5); break;
+            }
+            expression += line;
+        }
+        expression += ";";
+        WriteSourceLine(SOURCE, 1, expression.c_str(), lines);
+
+        // UNCHECKED block
+        WriteSourceLine(SOURCE, 1, "UNCHECKED", lines);
+        WriteSourceLine(SOURCE, 1, "{", lines);
+        sprintf(line, "s, i <- s * 2 + g%d;", b);
+        WriteSourceLine(SOURCE, 2, line, lines);
+        WriteSourceLine(SOURCE, 2, "OUTPUT(s, ENDL);", lines);
+        WriteSourceLine(SOURCE, 1, "}", lines);
+        WriteSourceLine(SOURCE, 1, "CONCLUDED;", lines);
+    }
+    WriteSourceLine(SOURCE, 0, "}", lines);
+    WriteSourceLine(SOURCE, 0, "END", lines);
+    bytes = (long long)SOURCE.tellp();
+    SOURCE.close();
+    return(lines);
+}
+
+//-----------------------------------------------------------
+void CompileBenchmarkSource(bool timeReportON, COMPILESAMPLE& sample)
+//-----------------------------------------------------------
+{
+    bool CompileSourceFile(const char sourceFileName[]);
+
+#ifdef _WIN32
+    ofstream CONSOLE("NUL");
+#else
+    ofstream CONSOLE("/dev/null");
+#endif
+    streambuf* consoleBuffer;
+    chrono::steady_clock::time_point start;
+
+    // The compiler still echoes the source program, but to the null device
+    consoleBuffer = cout.rdbuf(CONSOLE.rdbuf());
+    statistics.SetON(timeReportON);
+    allocationCount = 0;
+    allocatedBytes = 0;
+    start = chrono::steady_clock::now();
+    sample.isCompiled = CompileSourceFile(BENCHMARKFILENAME);
+    sample.seconds = SecondsSince(start);
+    cout.rdbuf(consoleBuffer);
+    for (int i = 0; i <= STATISTICS::PHASES - 1; i++)
+        sample.phaseSeconds[i] = statistics.GetSeconds((STATISTICS::PHASE)i);
+    sample.tokens = statistics.GetCount(STATISTICS::TOKENS);
+    sample.allocations = allocationCount;
+    sample.bytesAllocated = allocatedBytes;
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memoryCounters;
+
+    GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters));
+    sample.peakRSS = (long long)memoryCounters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    sample.peakRSS = (long long)usage.ru_maxrss;
+#else
+    sample.peakRSS = (long long)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+//-----------------------------------------------------------
+bool CompileInChildProcess(bool timeReportON, COMPILESAMPLE& sample)
+//-----------------------------------------------------------
+{
+    // Returns false when no (more) compiles can be measured
+#ifdef _WIN32
+    static bool isCompiled = false;
+
+    if (isCompiled) return(false);
+    isCompiled = true;
+    CompileBenchmarkSource(timeReportON, sample);
+    return(sample.isCompiled);
+#else
+    int pipeFDs[2];
+    pid_t child;
+    size_t received = 0;
+    int status;
+
+    cout.flush();
+    if (pipe(pipeFDs) != 0) return(false);
+    child = fork();
+    if (child == 0)
+    {
+        close(pipeFDs[0]);
+        CompileBenchmarkSource(timeReportON, sample);
+        if (write(pipeFDs[1], &sample, sizeof(sample)) != (ssize_t)sizeof(sample)) _exit(1);
+        _exit(0);
+    }
+    close(pipeFDs[1]);
+    while (child > 0)
+    {
+        ssize_t n = read(pipeFDs[0], (char*)&sample + received, sizeof(sample) - received);
+
+        if (n <= 0) break;
+        received += (size_t)n;
+    }
+    close(pipeFDs[0]);
+    if (child > 0) waitpid(child, &status, 0);
+    return((received == sizeof(sample)) && sample.isCompiled);
+#endif
+}
+
+//-----------------------------------------------------------
+double Quantile(vector<double> values, double q)
+//-----------------------------------------------------------
+{
+    // Interpolates between the two nearest of the sorted values (q = 0.5 is the median)
+    sort(values.begin(), values.end());
+
+    const double position = q * (values.size() - 1);
+    const int i = (int)position;
+
+    if (i >= (int)values.size() - 1) return(values[values.size() - 1]);
+    return(values[i] + (position - i) * (values[i + 1] - values[i]));
+}
+
+//-----------------------------------------------------------
+double Median(const vector<double>& values)
+//-----------------------------------------------------------
+{
+    return(Quantile(values, 0.5));
+}
+
+//-----------------------------------------------------------
+void BenchmarkCompiler(const WORKLOAD& workload, int compiles)
+//-----------------------------------------------------------
+{
+    /*
+       End to end: the median of at least compiles compiles with the time report OFF
+          (more, up to 100, until they add up to 3 seconds), after 3 more compiles
+          that warm the file system cache and the CPU (the spread is
+          (third quartile - first quartile) / median, a measure of how stable the
+          result is that one descheduled compile cannot inflate; the range,
+          (slowest - fastest) / median, is reported next to it). The fastest
+          compile is reported too: other load on the machine can only slow a
+          compile down, so it is the steadier number to compare runs by.
+          Per phase: the median of 3 compiles with the time report ON, which also
+          counts the tokens; its clock reads make those compiles slower.
+    */
+    const int WARMUPCOMPILES = 3;
+    const int MAXIMUMCOMPILES = 100;
+    const double MINIMUMSECONDS = 3.0;
+    const int PHASECOMPILES = 3;
+    long long bytes;
+    long long lines = WriteSyntheticSource(workload, bytes);
+    vector<double> seconds;
+    vector<double> phaseSeconds[STATISTICS::PHASES];
+    COMPILESAMPLE sample;
+    long long tokens = 0;
+    long long peakRSS = 0;
+    long long allocations = 0;
+    long long bytesAllocated = 0;
+    char information[SOURCELINELENGTH + 1];
+
+    sprintf(information, "Compiler end to end, workload %s (%lld lines, %.1f MB of source)",
+        workload.name, lines, bytes / (1024.0 * 1024.0));
+    cout << information << endl;
+    if (!CompileInChildProcess(false, sample))
+    {
+        cout << "   (the workload did not compile)" << endl;
+        return;
+    }
+    const COMPILESAMPLE warmUp = sample;
+
+    for (int i = 2; i <= WARMUPCOMPILES; i++)
+        if (!CompileInChildProcess(false, sample)) break;
+
+    double totalSeconds = 0;
+
+    for (int i = 1; (i <= compiles) || ((totalSeconds < MINIMUMSECONDS) && (i <= MAXIMUMCOMPILES)); i++)
+    {
+        if (!CompileInChildProcess(false, sample)) break;
+        seconds.push_back(sample.seconds);
+        totalSeconds += sample.seconds;
+        peakRSS = max(peakRSS, sample.peakRSS);
+        allocations = sample.allocations;
+        bytesAllocated = sample.bytesAllocated;
+    }
+    for (int i = 1; i <= PHASECOMPILES; i++)
+    {
+        if (!CompileInChildProcess(true, sample)) break;
+        for (int k = 0; k <= STATISTICS::PHASES - 1; k++)
+            phaseSeconds[k].push_back(sample.phaseSeconds[k]);
+        tokens = sample.tokens;
+    }
+    // Only one compile can be measured under _WIN32
+    if (seconds.empty())
+    {
+        seconds.push_back(warmUp.seconds);
+        peakRSS = warmUp.peakRSS;
+        allocations = warmUp.allocations;
+        bytesAllocated = warmUp.bytesAllocated;
+    }
+
+    const double median = Median(seconds);
+
+    sprintf(information, "   %-44s %9.3f ms  %9.0f lines/s  spread %.1f%% (%d compiles, range %.1f%%)",
+        "end to end", median * 1000.0, lines / median,
+        100.0 * (Quantile(seconds, 0.75) - Quantile(seconds, 0.25)) / median,
+        (int)seconds.size(),
+        100.0 * (*max_element(seconds.begin(), seconds.end()) - *min_element(seconds.begin(), seconds.end())) / median);
+    cout << information << endl;
+    sprintf(information, "   %-44s %9.3f ms  %9.0f lines/s",
+        "end to end (fastest compile)", *min_element(seconds.begin(), seconds.end()) * 1000.0,
+        lines / *min_element(seconds.begin(), seconds.end()));
+    cout << information << endl;
+    if (!phaseSeconds[0].empty())
+    {
+        double total = 0;
+
+        sprintf(information, "   %-44s %9.3f ms  %9.0f tokens/s  (count = %lld)",
+            "tokens", median * 1000.0, tokens / median, tokens);
+        cout << information << endl;
+        for (int k = 0; k <= STATISTICS::PHASES - 1; k++)
+            total += Median(phaseSeconds[k]);
+        for (int k = 0; k <= STATISTICS::PHASES - 1; k++)
+        {
+            char description[80 + 1];
+
+            snprintf(description, sizeof(description), "phase %.15s (time report ON)", STATISTICS::GetPhaseName((STATISTICS::PHASE)k));
+            sprintf(information, "   %-44s %9.3f ms  %7.1f%%", description,
+                Median(phaseSeconds[k]) * 1000.0, 100.0 * Median(phaseSeconds[k]) / total);
+            cout << information << endl;
+        }
+    }
+    sprintf(information, "   Memory: peak RSS %.1f MB, %lld allocations (%.1f MB allocated)",
+        peakRSS / (1024.0 * 1024.0), allocations, bytesAllocated / (1024.0 * 1024.0));
+    cout << information << endl;
+}
+
+//===========================================================
+// Peephole optimizer benchmark: dynamic instructions saved on a reference workload
+//===========================================================
+/*
+   STM itself is not available here, so STMMACHINE executes a CODE instruction list
+      directly: one word per instruction, static data after the code, the run-time
+      stack growing down from RUNTIMESTACK, 16-bit integers with TRUE = 0XFFFF. It
+      implements what AGL emits and counts every instruction executed.
+*/
+//===========================================================
+class STMMACHINE
+//===========================================================
+{
+private:
+    static const int MEMORYSIZE = 65536;
+
+    CODE& code;
+    vector<const CODE::INSTRUCTION*> program;   // the instruction at each code address (NULL = none)
+    vector<int> memory;
+    vector<int> symbolValues;                   // indexed by text ID
+    vector<char> isSymbolDefined;
+    string error;
+
+public:
+    STMMACHINE(CODE& code) : code(code)
+    {
+        memory.assign(MEMORYSIZE, 0);
+    }
+    bool Load();
+    bool Run(long long maximumSteps, long long& steps, string& output);
+    const char* GetError()
+    {
+        return(error.c_str());
+    }
+
+private:
+    void DefineSymbol(int text, int value)
+    {
+        if (text >= (int)symbolValues.size())
+        {
+            symbolValues.resize(text + 1, 0);
+            isSymbolDefined.resize(text + 1, 0);
+        }
+        symbolValues[text] = value;
+        isSymbolDefined[text] = 1;
+    }
+    bool GetSymbol(int text, int& value)
+    {
+        if ((text >= (int)symbolValues.size()) || !isSymbolDefined[text])
+        {
+            error = string("Undefined symbol ") + code.GetText(text);
+            return(false);
+        }
+        value = symbolValues[text];
+        return(true);
+    }
+    bool GetNumber(const CODE::INSTRUCTION& instruction, int& value);
+    bool GetAddress(const CODE::INSTRUCTION& instruction, int SP, int SB, int& address);
+    static int Word(int value)
+    {
+        return((int)(short)(value & 0XFFFF));
+    }
+};
+
+//-----------------------------------------------------------
+bool STMMACHINE::GetNumber(const CODE::INSTRUCTION& instruction, int& value)
+//-----------------------------------------------------------
+{
+    // EQU, ORG, RW, and DW operands: 0Dn, 0Xh..h, 0Bb..b, or a symbol
+    if (instruction.operandKind == CODE::CONSTANTOPERAND)
+    {
+        value = instruction.operand;
+        return(true);
+    }
+    if (instruction.operandKind == CODE::LABELOPERAND)
+        return(GetSymbol(instruction.operand, value));
+    if (instruction.operandKind == CODE::TEXTOPERAND)
+    {
+        const char* text = code.GetText(instruction.operand);
+
+        if ((strncmp(text, "0X", 2) == 0) || (strncmp(text, "0B", 2) == 0))
+        {
+            value = (int)strtol(&text[2], NULL, (text[1] == 'X') ? 16 : 2);
+            return(true);
+        }
+    }
+    error = "Unsupported directive operand";
+    return(false);
+}
+
+//-----------------------------------------------------------
+bool STMMACHINE::Load()
+//-----------------------------------------------------------
+{
+    // Two passes: lay out code and data (defining labels), then initialize data
+    const vector<CODE::INSTRUCTION>& instructions = code.GetInstructions();
+
+    for (int pass = 1; pass <= 2; pass++)
+    {
+        int location = 0;
+
+        program.assign(MEMORYSIZE, NULL);
+        for (int i = 0; i <= (int)instructions.size() - 1; i++)
+        {
+            const CODE::INSTRUCTION& instruction = instructions[i];
+            int value;
+
+            if ((instruction.opcode == CODE::STM_COMMENTLINE) || (instruction.opcode == CODE::STM_UNFORMATTEDLINE)) continue;
+            if (location >= MEMORYSIZE)
+            {
+                error = "Program does not fit in memory";
+                return(false);
+            }
+            if (instruction.opcode == CODE::STM_EQU)
+            {
+                if (instruction.operandKind == CODE::LOCATIONOPERAND)
+                    value = location;
+                else if (!GetNumber(instruction, value))
+                    return(false);
+                DefineSymbol(instruction.label, value);
+                continue;
+            }
+            if (instruction.label != 0) DefineSymbol(instruction.label, location);
+            switch (instruction.opcode)
+            {
+            case CODE::STM_ORG:
+                if (!GetNumber(instruction, location)) return(false);
+                break;
+            case CODE::STM_RW:
+                if (!GetNumber(instruction, value)) return(false);
+                location += value;
+                break;
+            case CODE::STM_DW:
+                if ((pass == 2) && !GetNumber(instruction, memory[location])) return(false);
+                location += 1;
+                break;
+            case CODE::STM_DS:
+            {
+                // capacity, length, then one character per word
+                const char* characters = code.GetText(instruction.operand);
+                const int length = (int)strlen(characters);
+
+                if (pass == 2)
+                {
+                    memory[location] = length;
+                    memory[location + 1] = length;
+                    for (int k = 0; k <= length - 1; k++)
+                        memory[location + 2 + k] = (unsigned char)characters[k];
+                }
+                location += 2 + length;
+                break;
+            }
+            default:
+                program[location] = &instruction;
+                location += 1;
+                break;
+            }
+        }
+    }
+    return(true);
+}
+
+//-----------------------------------------------------------
+bool STMMACHINE::GetAddress(const CODE::INSTRUCTION& instruction, int SP, int SB, int& address)
+//-----------------------------------------------------------
+{
+    switch (instruction.operandKind)
+    {
+    case CODE::SBOPERAND:
+        address = SB + instruction.operand;
+        break;
+    case CODE::SPOPERAND:
+        address = SP + instruction.operand;
+        break;
+    case CODE::INDIRECTSPOPERAND:
+        if ((SP + instruction.operand < 0) || (SP + instruction.operand >= MEMORYSIZE))
+        {
+            error = "Stack address out of range";
+            return(false);
+        }
+        address = memory[SP + instruction.operand] & 0XFFFF;
+        break;
+    case CODE::LABELOPERAND:
+        if (!GetSymbol(instruction.operand, address)) return(false);
+        break;
+    default:
+        error = string("Unsupported memory operand for ") + code.GetText(0);
+        return(false);
+    }
+    if ((address < 0) || (address >= MEMORYSIZE))
+    {
+        error = "Address out of range";
+        return(false);
+    }
+    return(true);
+}
+
+//-----------------------------------------------------------
+bool STMMACHINE::Run(long long maximumSteps, long long& steps, string& output)
+//-----------------------------------------------------------
+{
+    int PC = 0, SP = MEMORYSIZE - 1, SB = 0;
+    int condition = 0;          // sign of the CMPI difference or of the SETNZPI operand
+    bool isTrue = false;        // SETT
+    int a, b, address;
+    char digits[11 + 1];
+
+#define PUSH(value) { if (SP <= 0) { error = "Stack overflow"; return(false); } memory[--SP] = (value); }
+#define POP(value) { if (SP >= MEMORYSIZE) { error = "Stack underflow"; return(false); } (value) = memory[SP++]; }
+
+    steps = 0;
+    output.clear();
+    while (steps < maximumSteps)
+    {
+        if ((PC < 0) || (PC >= MEMORYSIZE) || (program[PC] == NULL))
+        {
+            error = "No instruction at PC";
+            return(false);
+        }
+
+        const CODE::INSTRUCTION& instruction = *program[PC];
+
+        steps++;
+        PC++;
+        switch (instruction.opcode)
+        {
+        case CODE::STM_PUSH:
+            switch (instruction.operandKind)
+            {
+            case CODE::IMMEDIATEOPERAND:
+                a = instruction.operand;
+                break;
+            case CODE::HEXIMMEDIATEOPERAND:
+                a = Word(instruction.operand);
+                break;
+            case CODE::SYMBOLIMMEDIATEOPERAND:
+                if (!GetSymbol(instruction.operand, a)) return(false);
+                break;
+            default:
+                if (!GetAddress(instruction, SP, SB, address)) return(false);
+                a = memory[address];
+                break;
+            }
+            PUSH(a);
+            break;
+        case CODE::STM_PUSHA:
+            if (!GetAddress(instruction, SP, SB, address)) return(false);
+            PUSH(address);
+            break;
+        case CODE::STM_POP:
+            // (@SP:0Dn is taken *before* the pop)
+            if (!GetAddress(instruction, SP, SB, address)) return(false);
+            POP(memory[address]);
+            break;
+        case CODE::STM_POPSP:
+            POP(a);
+            SP = a & 0XFFFF;
+            break;
+        case CODE::STM_POPSB:
+            POP(a);
+            SB = a & 0XFFFF;
+            break;
+        case CODE::STM_DISCARD:
+            SP += instruction.operand;
+            break;
+        case CODE::STM_MAKEDUP:
+            a = memory[SP];
+            PUSH(a);
+            break;
+        case CODE::STM_SWAP:
+            swap(memory[SP], memory[SP + 1]);
+            break;
+        case CODE::STM_ADDI: case CODE::STM_SUBI: case CODE::STM_MULI: case CODE::STM_DIVI:
+        case CODE::STM_REMI: case CODE::STM_POWI: case CODE::STM_AND: case CODE::STM_OR:
+        case CODE::STM_XOR: case CODE::STM_NAND: case CODE::STM_NOR: case CODE::STM_CMPI:
+            POP(b);
+            POP(a);
+            switch (instruction.opcode)
+            {
+            case CODE::STM_ADDI: a = a + b; break;
+            case CODE::STM_SUBI: a = a - b; break;
+            case CODE::STM_MULI: a = a * b; break;
+            case CODE::STM_DIVI:
+            case CODE::STM_REMI:
+                if (b == 0)
+                {
+                    error = "Division by zero";
+                    return(false);
+                }
+                a = (instruction.opcode == CODE::STM_DIVI) ? a / b : a % b;
+                break;
+            case CODE::STM_POWI:
+            {
+                int power = 1;
+
+                for (int k = 1; k <= b; k++)
+                    power = Word(power * a);
+                a = power;
+                break;
+            }
+            case CODE::STM_AND: a = a & b; break;
+            case CODE::STM_OR: a = a | b; break;
+            case CODE::STM_XOR: a = a ^ b; break;
+            case CODE::STM_NAND: a = ~(a & b); break;
+            case CODE::STM_NOR: a = ~(a | b); break;
+            case CODE::STM_CMPI: condition = (a < b) ? -1 : ((a == b) ? 0 : 1); break;
+            }
+            if (instruction.opcode != CODE::STM_CMPI) PUSH(Word(a));
+            break;
+        case CODE::STM_NEGI:
+            memory[SP] = Word(-memory[SP]);
+            break;
+        case CODE::STM_NOT:
+            memory[SP] = Word(~memory[SP]);
+            break;
+        case CODE::STM_SETNZPI:
+            condition = (memory[SP] < 0) ? -1 : ((memory[SP] == 0) ? 0 : 1);
+            break;
+        case CODE::STM_SETT:
+            isTrue = (memory[SP] != 0);
+            break;
+        case CODE::STM_JMP: case CODE::STM_JMPL: case CODE::STM_JMPLE: case CODE::STM_JMPE:
+        case CODE::STM_JMPNE: case CODE::STM_JMPG: case CODE::STM_JMPGE: case CODE::STM_JMPNN:
+        case CODE::STM_JMPT: case CODE::STM_JMPNT: case CODE::STM_CALL:
+        {
+            bool isJump = false;
+
+            switch (instruction.opcode)
+            {
+            case CODE::STM_JMP: case CODE::STM_CALL: isJump = true; break;
+            case CODE::STM_JMPL: isJump = (condition < 0); break;
+            case CODE::STM_JMPLE: isJump = (condition <= 0); break;
+            case CODE::STM_JMPE: isJump = (condition == 0); break;
+            case CODE::STM_JMPNE: isJump = (condition != 0); break;
+            case CODE::STM_JMPG: isJump = (condition > 0); break;
+            case CODE::STM_JMPGE: case CODE::STM_JMPNN: isJump = (condition >= 0); break;
+            case CODE::STM_JMPT: isJump = isTrue; break;
+            case CODE::STM_JMPNT: isJump = !isTrue; break;
+            }
+            if (instruction.opcode == CODE::STM_CALL) PUSH(PC);
+            if (isJump && !GetSymbol(instruction.operand, PC)) return(false);
+            break;
+        }
+        case CODE::STM_RETURN:
+            POP(PC);
+            break;
+        case CODE::STM_SVC:
+            if (!GetSymbol(instruction.operand, a)) return(false);
+            switch (a)
+            {
+            case 0:                                         // SVC_DONOTHING
+                break;
+            case 1:                                         // SVC_TERMINATE
+                return(true);
+            case 10: case 30:                               // SVC_READ_INTEGER, SVC_READ_BOOLEAN (no input)
+                PUSH(0);
+                break;
+            case 11:                                        // SVC_WRITE_INTEGER
+                POP(a);
+                sprintf(digits, "%d", a);
+                output += digits;
+                break;
+            case 31:                                        // SVC_WRITE_BOOLEAN
+                POP(a);
+                output += (a != 0) ? "true" : "false";
+                break;
+            case 41:                                        // SVC_WRITE_CHARACTER
+                POP(a);
+                output += (char)a;
+                break;
+            case 42:                                        // SVC_WRITE_ENDL
+                output += '\n';
+                break;
+            case 51:                                        // SVC_WRITE_STRING
+                POP(address);
+                for (int k = 0; (k <= memory[address + 1] - 1) && (address + 2 + k < MEMORYSIZE); k++)
+                    output += (char)memory[address + 2 + k];
+                break;
+            case 90:                                        // SVC_INITIALIZE_HEAP
+                SP += 2;
+                break;
+            default:
+                error = "Unsupported SVC";
+                return(false);
+            }
+            break;
+        default:
+            error = "Unsupported opcode";
+            return(false);
+        }
+    }
+#undef PUSH
+#undef POP
+    error = "Did not terminate";
+    return(false);
+}
+
+//-----------------------------------------------------------
+void WriteReferenceSource(int iterations)
+//-----------------------------------------------------------
+{
+    // Assignments, a DECREE/LEST/OTHERWISE chain, and a boolean variable in two nested WHILSTs
+    const char* LINES[] =
+    {
+        "ORDAIN MUTABLE i : INTEGER <- 0, MUTABLE j : INTEGER <- 0;",
+        "ORDAIN MUTABLE s : INTEGER <- 0, MUTABLE t : INTEGER <- 0;",
+        "ORDAIN MUTABLE odd : TESTAMENT <- FALSEHOOD;",
+        "MAIN",
+        "{",
+        "   WHILST (i < %d) MAINTAIN",
+        "   {",
+        "      j <- 0;",
+        "      WHILST (j < 50) MAINTAIN",
+        "      {",
+        "         DECREE (j %% 3 = 0) THEN { s <- (s + j) %% 1000; }",
+        "         LEST (j %% 3 = 1) THEN { t <- (t + 1) %% 1000; }",
+        "         OTHERWISE { s, t <- (s + t) %% 997; } CONCLUDED;",
+        "         odd <- (j %% 2 = 1);",
+        "         DECREE (odd) THEN { t <- (t + 3) %% 1000; } CONCLUDED;",
+        "         DECREE (s >= t) THEN { OUTPUT(\"s\"); } OTHERWISE { OUTPUT(\"t\"); } CONCLUDED;",
+        "         j <- j + 1;",
+        "      } CONCLUDED;",
+        "      OUTPUT(ENDL);",
+        "      i <- i + 1;",
+        "   } CONCLUDED;",
+        "   OUTPUT(\"s = \", s, ENDL, \"t = \", t, ENDL);",
+        "}",
+        "END"
+    };
+    char fullFileName[80 + 1], line[SOURCELINELENGTH + 1];
+
+    sprintf(fullFileName, "%s.agl", BENCHMARKFILENAME);
+    ofstream SOURCE(fullFileName, ios::out);
+
+    for (int i = 0; i <= (int)(sizeof(LINES) / sizeof(LINES[0])) - 1; i++)
+    {
+        sprintf(line, LINES[i], iterations);
+        SOURCE << line << '\n';
+    }
+}
+
+//-----------------------------------------------------------
+void ReplaySTMFile(const char fullFileName[], CODE& replay)
+//-----------------------------------------------------------
+{
+    // Emit the lines of a .stm file again, through replay's EmitFormattedLine()
+    ifstream STM(fullFileName, ios::in);
+    string line;
+
+    while (getline(STM, line))
+    {
+        string fields[4];             // label, mnemonic, operand, comment
+        size_t i = 0;
+
+        if ((line.find_first_not_of(' ') == string::npos) || (line[line.find_first_not_of(' ')] == ';'))
+        {
+            replay.EmitUnformattedLine(line.c_str());
+            continue;
+        }
+        for (int field = 0; field <= 2; field++)
+        {
+            size_t end;
+
+            if ((field > 0) || (line[0] == ' ')) i = line.find_first_not_of(' ', i);
+            if ((field == 0) && (line[0] == ' ')) continue;
+            if (i == string::npos) break;
+            if ((field == 2) && (line[i] == '"'))
+            {
+                // A string operand (with \-escapes) may contain blanks and ';'
+                end = i + 1;
+                while ((end < line.size()) && (line[end] != '"'))
+                    end += (line[end] == '\\') ? 2 : 1;
+                end = min(end + 1, line.size());
+            }
+            else if (field == 2)
+            {
+                end = line.find(" ; ", i);
+                if (end == string::npos) end = line.size();
+                end = line.find_last_not_of(' ', end - 1) + 1;
+            }
+            else
+            {
+                end = line.find(' ', i);
+                if (end == string::npos) end = line.size();
+            }
+            fields[field] = line.substr(i, end - i);
+            i = end;
+        }
+        if ((i != string::npos) && (line.find(" ; ", i) != string::npos))
+            fields[3] = line.substr(line.find(" ; ", i) + 3);
+        replay.EmitFormattedLine(fields[0].c_str(), fields[1].c_str(), fields[2].c_str(), fields[3].c_str());
+    }
+}
+
+//-----------------------------------------------------------
+void BenchmarkPeepholeOptimizer(int iterations)
+//-----------------------------------------------------------
+{
+    /*
+       The reference workload is compiled once with the peephole optimizer OFF; its
+          .stm is then emitted again (REPLAYS times, for the timing) through a CODE
+          with the optimizer OFF and one with it ON, and the last two instruction
+          lists are executed. The two runs must write the same output.
+    */
+    const int REPLAYS = 200;
+    const long long MAXIMUMSTEPS = 1000000000LL;
+    char fullFileName[80 + 1], information[SOURCELINELENGTH + 1];
+    COMPILESAMPLE sample;
+    CODE* replays[2] = { NULL, NULL };
+    long long steps[2] = { 0, 0 }, instructions[2] = { 0, 0 };
+    string outputs[2];
+    double baselineSeconds = 0;
+
+    WriteReferenceSource(iterations);
+    cout << "Peephole optimizer (reference workload, " << iterations << " x 50 inner iterations)" << endl;
+
+    // (the forked child compiles with the global code's setting)
+    code.SetPeepholeOptimizerON(false);
+    if (!CompileInChildProcess(false, sample))
+    {
+        cout << "   (the reference workload did not compile)" << endl;
+        return;
+    }
+    sprintf(fullFileName, "%s.stm", BENCHMARKFILENAME);
+    for (int k = 0; k <= 1; k++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long lines = 0;
+
+        for (int i = 1; i <= REPLAYS; i++)
+        {
+            delete replays[k];
+            replays[k] = new CODE;
+            replays[k]->SetPeepholeOptimizerON(k == 1);
+            ReplaySTMFile(fullFileName, *replays[k]);
+            lines += (long long)replays[k]->GetInstructions().size();
+        }
+        if (k == 0) baselineSeconds = SecondsSince(start);
+        ReportResult((k == 0) ? "emit .stm again, optimizer OFF" : "emit .stm again, optimizer ON",
+            SecondsSince(start), baselineSeconds, lines);
+    }
+    for (int k = 0; k <= 1; k++)
+    {
+        STMMACHINE machine(*replays[k]);
+
+        for (int i = 0; i <= (int)replays[k]->GetInstructions().size() - 1; i++)
+        {
+            const unsigned char opcode = replays[k]->GetInstructions()[i].opcode;
+
+            if ((opcode != CODE::STM_COMMENTLINE) && (opcode != CODE::STM_UNFORMATTEDLINE) && (opcode != CODE::STM_EQU)
+                && (opcode != CODE::STM_ORG) && (opcode != CODE::STM_RW) && (opcode != CODE::STM_DW) && (opcode != CODE::STM_DS))
+                instructions[k]++;
+        }
+        if (!machine.Load() || !machine.Run(MAXIMUMSTEPS, steps[k], outputs[k]))
+        {
+            cout << "   (the STM program " << ((k == 0) ? "without" : "with") << " the optimizer failed: " << machine.GetError() << ")" << endl;
+            delete replays[0];
+            delete replays[1];
+            return;
+        }
+    }
+    sprintf(information, "   %-44s %9lld -> %9lld  (%.1f%% fewer)", "instructions in the program",
+        instructions[0], instructions[1], 100.0 * (instructions[0] - instructions[1]) / instructions[0]);
+    cout << information << endl;
+    sprintf(information, "   %-44s %9lld -> %9lld  (%.1f%% fewer, %lld saved)", "dynamic instructions executed",
+        steps[0], steps[1], 100.0 * (steps[0] - steps[1]) / steps[0], steps[0] - steps[1]);
+    cout << information << endl;
+    for (int rule = 0; rule <= CODE::PEEPHOLERULES - 1; rule++)
+    {
+        char description[80 + 1];
+
+        snprintf(description, sizeof(description), "rule \"%.31s\"", CODE::GetPeepholeRuleName((CODE::PEEPHOLERULE)rule));
+        sprintf(information, "   %-44s %9lld hits", description, replays[1]->GetPeepholeHits((CODE::PEEPHOLERULE)rule));
+        cout << information << endl;
+    }
+    cout << "   program output " << ((outputs[0] == outputs[1]) ? "identical" : "DIFFERS") << " ("
+        << outputs[0].size() << " characters)" << endl;
+    delete replays[0];
+    delete replays[1];
+}
+
+//-----------------------------------------------------------
+int main(int argc, char* argv[])
+//-----------------------------------------------------------
+{
+    // Same shape, 10 times the size of the workload before
+    const WORKLOAD WORKLOADS[] =
+    {
+        { "small", 100, 40, 8, 6, 32 },
+        { "medium", 1000, 400, 8, 6, 32 },
+        { "large", 10000, 4000, 8, 6, 32 }
+    };
+    const bool isCompilerOnly = (argc >= 2) && (strcmp(argv[1], "compile") == 0);
+
+    try
+    {
+        // First the benchmarks that compile, while the compiler's global objects are still untouched (the others use them)
+        for (int i = 0; i <= (int)(sizeof(WORKLOADS) / sizeof(WORKLOADS[0])) - 1; i++)
+        {
+            BenchmarkCompiler(WORKLOADS[i], 15);
+            RemoveBenchmarkFiles();
+        }
+        if (isCompilerOnly) return(0);
+        BenchmarkPeepholeOptimizer(2000);
+        RemoveBenchmarkFiles();
+
+        BenchmarkLongLineReader(20000);
+        RemoveBenchmarkFiles();
+        BenchmarkLister(1000000);
+        RemoveBenchmarkFiles();
+        BenchmarkCharacterRuns(200000);
+        RemoveBenchmarkFiles();
+        BenchmarkScanner(50000);
+        RemoveBenchmarkFiles();
+        BenchmarkIdentifierTable(1000000);
+        RemoveBenchmarkFiles();
+        BenchmarkSTMWriter(10000000);
+        RemoveBenchmarkFiles();
+    }
+    catch (AGLEXCEPTION aglException)
+    {
+        RemoveBenchmarkFiles();
+        cout << "AGL exception: " << aglException.GetDescription() << endl;
+        return(1);
+    }
+    return(0);
+}
@@ -13,14 +13,24 @@
 #include <cstring>
 #include <cctype>
 #include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 
-//#define TRACEREADER
-//#define TRACESCANNER
-//#define TRACEPARSER
-#define TRACEIDENTIFIERTABLE
-#define TRACECOMPILER
+#define MAPPEDSOURCEREADER
+#define BACKGROUNDLISTER
+#define SIMDSCANNER
+#define LITERALPOOL
+#define PEEPHOLEOPTIMIZER         // (the CODE default; SetPeepholeOptimizerON() changes it)
+//#define PRETOKENIZEDSOURCE
+//#define PARALLELSCANNER           // (requires PRETOKENIZEDSOURCE)
+//#define LISTINGONERRORONLY
+// Traces are selected at run time by the AGLTRACE environment variable (see main())
 
 #include "AGLHeader.h"
 
@@ -137,7 +147,7 @@ struct TOKENTABLERECORD
 };
 
 //-----------------------------------------------------------
-const TOKENTABLERECORD TOKENTABLE[] =
+constexpr TOKENTABLERECORD TOKENTABLE[] =
 //-----------------------------------------------------------
 {
    { IDENTIFIER     ,"IDENTIFIER"     ,false },
@@ -196,16 +206,406 @@ const TOKENTABLERECORD TOKENTABLE[] =
    { POWER          ,"POWER"          ,false }
 };
 
+//-----------------------------------------------------------
+constexpr bool IsTOKENTABLEInTOKENTYPEOrder()
+//-----------------------------------------------------------
+{
+    for (int i = 0; i <= (int)(sizeof(TOKENTABLE) / sizeof(TOKENTABLERECORD)) - 1; i++)
+        if ((int)TOKENTABLE[i].type != i) return(false);
+    return(true);
+}
+
+// TokenDescription() indexes TOKENTABLE[] by TOKENTYPE
+static_assert(IsTOKENTABLEInTOKENTYPEOrder(), "TOKENTABLE[] must list the TOKENTYPEs in declaration order");
+
+//===========================================================
+class RESERVEDWORDTABLE
+    //===========================================================
+{
+    /*
+       Perfect hash of the reserved words in TOKENTABLE[], built by the C++ compiler:
+          the constructor tries seeds until Hash() sends every reserved word to its
+          own slot. Find() hashes a lexeme case-insensitively in place and needs one
+          case-insensitive comparison to confirm the match (no copy, no table scan).
+    */
+public:
+    static const int SLOTS = 256;
+    static const unsigned char EMPTY = 0XFF;
+
+private:
+    unsigned int seed;
+    bool isPerfect;
+    int longestReservedWord;
+    unsigned char slots[SLOTS];   // TOKENTABLE[] index of reserved word or EMPTY
+
+public:
+    constexpr RESERVEDWORDTABLE() : seed(0), isPerfect(false), longestReservedWord(0), slots{}
+    {
+        for (unsigned int trySeed = 1; !isPerfect && (trySeed <= 1000); trySeed++)
+            isPerfect = TrySeed(trySeed);
+    }
+    constexpr bool IsPerfect() const
+    {
+        return(isPerfect);
+    }
+    //-----------------------------------------------------------
+    int Find(const char lexeme[], int length) const
+    //-----------------------------------------------------------
+    {
+        // Returns TOKENTABLE[] index of reserved word lexeme or -1 (lexeme is an identifier)
+        if (length > longestReservedWord) return(-1);
+
+        int i = slots[Hash(seed, lexeme, length)];
+
+        if (i == EMPTY) return(-1);
+        for (int k = 0; k <= length - 1; k++)
+            if (UpperCase(lexeme[k]) != TOKENTABLE[i].description[k]) return(-1);
+        return((TOKENTABLE[i].description[length] == '\0') ? i : -1);
+    }
+
+private:
+    static constexpr char UpperCase(char c)
+    {
+        return(((c >= 'a') && (c <= 'z')) ? (char)(c - 'a' + 'A') : c);
+    }
+    static constexpr int Length(const char s[])
+    {
+        int length = 0;
+
+        while (s[length] != '\0') length++;
+        return(length);
+    }
+    static constexpr int Hash(unsigned int seed, const char lexeme[], int length)
+    {
+        // FNV-1a over the upper-case characters, seeded, folded to a slot number
+        unsigned int h = 2166136261U ^ seed;
+
+        for (int k = 0; k <= length - 1; k++)
+            h = (h ^ (unsigned char)UpperCase(lexeme[k])) * 16777619U;
+        return((int)((h ^ (h >> 16)) & (SLOTS - 1)));
+    }
+    constexpr bool TrySeed(unsigned int trySeed)
+    {
+        seed = trySeed;
+        longestReservedWord = 0;
+        for (int slot = 0; slot <= SLOTS - 1; slot++)
+            slots[slot] = EMPTY;
+        for (int i = 0; i <= (int)(sizeof(TOKENTABLE) / sizeof(TOKENTABLERECORD)) - 1; i++)
+        {
+            if (TOKENTABLE[i].isReservedWord)
+            {
+                int length = Length(TOKENTABLE[i].description);
+                int slot = Hash(seed, TOKENTABLE[i].description, length);
+
+                if (slots[slot] != EMPTY) return(false);
+                slots[slot] = (unsigned char)i;
+                if (length > longestReservedWord) longestReservedWord = length;
+            }
+        }
+        return(true);
+    }
+};
+
+constexpr RESERVEDWORDTABLE RESERVEDWORDS;
+static_assert(RESERVEDWORDS.IsPerfect(), "No perfect hash seed found for the reserved words");
+
 //-----------------------------------------------------------
 struct TOKEN
     //-----------------------------------------------------------
 {
     TOKENTYPE type;
-    char lexeme[SOURCELINELENGTH + 1];
+    string lexeme;       // any length; storage is re-used from token to token
+    int symbol;          // IDENTIFIERs only (otherwise 0): interned spelling (see IDENTIFIERINTERNER)
     int sourceLineNumber;
     int sourceLineIndex;
 };
 
+//===========================================================
+class SCANNERTABLES
+    //===========================================================
+{
+    /*
+       The deterministic finite automaton used by GetNextToken(), built by the C++
+          compiler. characterClasses[] maps each of the 256 characters to a
+          character class and transitions[state][class] gives the next state. A
+          next state >= FIRSTACCEPT ends the token: (next - FIRSTACCEPT)/2 is its
+          TOKENTYPE and the low bit tells whether the current character is part of
+          the token (<=) or starts the next one (<). STRING and EOPTOKEN states only
+          recognize the first character; GetNextToken() finishes those tokens.
+    */
+public:
+    enum CHARACTERCLASS
+    {
+        OTHERCLASS, LETTERCLASS, DIGITCLASS, UNDERSCORECLASS, SPACECLASS, EOLCLASS, EOPCLASS,
+        QUOTECLASS, LTCLASS, GTCLASS, EQCLASS, BANGCLASS, MINUSCLASS, STARCLASS, SLASHCLASS,
+        COMMACLASS, SEMICOLONCLASS, OBRACECLASS, CBRACECLASS, OPARENTHESISCLASS, CPARENTHESISCLASS,
+        COLONCLASS, PLUSCLASS, MODULUSCLASS, CARETCLASS,
+        CLASSES
+    };
+    enum SCANSTATE
+    {
+        // START and COMMENT are skip states; the rest are inside a token
+        STARTSTATE, COMMENTSTATE, IDENTIFIERSTATE, INTEGERSTATE, LTSTATE, GTSTATE, BANGSTATE, STARSTATE, SLASHSTATE,
+        STATES
+    };
+    static const int FIRSTACCEPT = 16;
+
+    unsigned char characterClasses[256];
+    unsigned char transitions[STATES][CLASSES];
+
+public:
+    constexpr SCANNERTABLES() : characterClasses{}, transitions{}
+    {
+        const char SINGLES[] = ",;{}():+%^=-";
+        const unsigned char SINGLECLASSES[] = { COMMACLASS, SEMICOLONCLASS, OBRACECLASS, CBRACECLASS,
+            OPARENTHESISCLASS, CPARENTHESISCLASS, COLONCLASS, PLUSCLASS, MODULUSCLASS, CARETCLASS, EQCLASS, MINUSCLASS };
+        const TOKENTYPE SINGLETYPES[] = { COMMA, SEMICOLON, OBRACE, CBRACE,
+            OPARENTHESIS, CPARENTHESIS, COLON, PLUS, MODULUS, POWER, EQ, MINUS };
+
+        for (int c = 0; c <= 255; c++)
+        {
+            if ((('A' <= c) && (c <= 'Z')) || (('a' <= c) && (c <= 'z')))
+                characterClasses[c] = LETTERCLASS;
+            else if (('0' <= c) && (c <= '9'))
+                characterClasses[c] = DIGITCLASS;
+            else if ((c <= 31) || (c == 127))
+                characterClasses[c] = SPACECLASS;     // READER changes control characters to ' '
+            else
+                characterClasses[c] = OTHERCLASS;
+        }
+        characterClasses[(unsigned char)'_'] = UNDERSCORECLASS;
+        characterClasses[(unsigned char)' '] = SPACECLASS;
+        characterClasses[(unsigned char)READER<CALLBACKSUSED, LOOKAHEAD>::TABC] = SPACECLASS;
+        characterClasses[(unsigned char)READER<CALLBACKSUSED, LOOKAHEAD>::EOLC] = EOLCLASS;
+        characterClasses[(unsigned char)READER<CALLBACKSUSED, LOOKAHEAD>::EOPC] = EOPCLASS;
+        characterClasses[(unsigned char)'"'] = QUOTECLASS;
+        characterClasses[(unsigned char)'<'] = LTCLASS;
+        characterClasses[(unsigned char)'>'] = GTCLASS;
+        characterClasses[(unsigned char)'!'] = BANGCLASS;
+        characterClasses[(unsigned char)'*'] = STARCLASS;
+        characterClasses[(unsigned char)'/'] = SLASHCLASS;
+        for (int i = 0; i <= (int)sizeof(SINGLECLASSES) - 1; i++)
+            characterClasses[(unsigned char)SINGLES[i]] = SINGLECLASSES[i];
+
+        // Unless overridden below, each state ends its token before the current character
+        for (int c = 0; c <= CLASSES - 1; c++)
+        {
+            transitions[STARTSTATE][c] = Accept(UNKTOKEN, true);
+            transitions[COMMENTSTATE][c] = COMMENTSTATE;
+            transitions[IDENTIFIERSTATE][c] = Accept(IDENTIFIER, false);
+            transitions[INTEGERSTATE][c] = Accept(INTEGER, false);
+            transitions[LTSTATE][c] = Accept(LT, false);
+            transitions[GTSTATE][c] = Accept(GT, false);
+            transitions[BANGSTATE][c] = Accept(UNKTOKEN, false);
+            transitions[STARSTATE][c] = Accept(MULTIPLY, false);
+            transitions[SLASHSTATE][c] = Accept(DIVIDE, false);
+        }
+        transitions[STARTSTATE][SPACECLASS] = STARTSTATE;
+        transitions[STARTSTATE][EOLCLASS] = STARTSTATE;
+        transitions[STARTSTATE][EOPCLASS] = Accept(EOPTOKEN, false);
+        transitions[STARTSTATE][QUOTECLASS] = Accept(STRING, false);
+        transitions[STARTSTATE][LETTERCLASS] = IDENTIFIERSTATE;
+        transitions[STARTSTATE][DIGITCLASS] = INTEGERSTATE;
+        transitions[STARTSTATE][LTCLASS] = LTSTATE;
+        transitions[STARTSTATE][GTCLASS] = GTSTATE;
+        transitions[STARTSTATE][BANGCLASS] = BANGSTATE;
+        transitions[STARTSTATE][STARCLASS] = STARSTATE;
+        transitions[STARTSTATE][SLASHCLASS] = SLASHSTATE;
+        for (int i = 0; i <= (int)sizeof(SINGLECLASSES) - 1; i++)
+            transitions[STARTSTATE][SINGLECLASSES[i]] = Accept(SINGLETYPES[i], true);
+        transitions[COMMENTSTATE][EOLCLASS] = STARTSTATE;
+        transitions[COMMENTSTATE][EOPCLASS] = STARTSTATE;
+        transitions[IDENTIFIERSTATE][LETTERCLASS] = IDENTIFIERSTATE;
+        transitions[IDENTIFIERSTATE][DIGITCLASS] = IDENTIFIERSTATE;
+        transitions[IDENTIFIERSTATE][UNDERSCORECLASS] = IDENTIFIERSTATE;
+        transitions[INTEGERSTATE][DIGITCLASS] = INTEGERSTATE;
+        transitions[LTSTATE][EQCLASS] = Accept(LTEQ, true);
+        transitions[LTSTATE][MINUSCLASS] = Accept(LEFTARROW, true);
+        transitions[GTSTATE][EQCLASS] = Accept(GTEQ, true);
+        transitions[BANGSTATE][EQCLASS] = Accept(NOTEQ, true);
+        transitions[STARSTATE][STARCLASS] = Accept(POWER, true);
+        transitions[SLASHSTATE][SLASHCLASS] = COMMENTSTATE;
+    }
+    static constexpr unsigned char Accept(TOKENTYPE type, bool isCharacterIncluded)
+    {
+        return((unsigned char)(FIRSTACCEPT + 2 * (int)type + (isCharacterIncluded ? 1 : 0)));
+    }
+};
+
+constexpr SCANNERTABLES SCANNER;
+static_assert(SCANNERTABLES::FIRSTACCEPT >= SCANNERTABLES::STATES, "SCANNERTABLES accept codes overlap its states");
+static_assert(SCANNERTABLES::FIRSTACCEPT + 2 * (int)POWER + 1 <= 255, "SCANNERTABLES accept codes must fit in a byte");
+
+//-----------------------------------------------------------
+// tokens[0] is the current token and tokens[1..LOOKAHEAD] are the look-ahead tokens
+//-----------------------------------------------------------
+typedef LOOKAHEADWINDOW<TOKEN, LOOKAHEAD> SCANNEDTOKENWINDOW;
+
+//===========================================================
+class TOKENBUFFER
+    //===========================================================
+{
+    /*
+       Every token of the source program (through the first EOPTOKEN) stored as a
+          struct of arrays. Lexemes are '\0'-terminated in the lexemes[] pool and
+          are addressed by offset and length.
+    */
+private:
+    vector<unsigned char> types;
+    vector<unsigned int> lexemeOffsets;
+    vector<unsigned int> lexemeLengths;
+    vector<int> symbols;
+    vector<int> sourceLineNumbers;
+    vector<int> sourceLineIndexes;
+    vector<char> lexemes;
+
+public:
+    //-----------------------------------------------------------
+    void Reserve(long long sourceSize)
+    //-----------------------------------------------------------
+    {
+        // Typical AGL averages about 4 source characters per token
+        const size_t tokens = (size_t)(sourceSize / 4) + 1;
+
+        types.reserve(tokens);
+        lexemeOffsets.reserve(tokens);
+        lexemeLengths.reserve(tokens);
+        symbols.reserve(tokens);
+        sourceLineNumbers.reserve(tokens);
+        sourceLineIndexes.reserve(tokens);
+        lexemes.reserve((size_t)sourceSize + tokens);
+    }
+    //-----------------------------------------------------------
+    void Add(const TOKEN& token)
+    //-----------------------------------------------------------
+    {
+        types.push_back((unsigned char)token.type);
+        lexemeOffsets.push_back((unsigned int)lexemes.size());
+        lexemeLengths.push_back((unsigned int)token.lexeme.size());
+        symbols.push_back(token.symbol);
+        sourceLineNumbers.push_back(token.sourceLineNumber);
+        sourceLineIndexes.push_back(token.sourceLineIndex);
+        lexemes.insert(lexemes.end(), token.lexeme.c_str(), token.lexeme.c_str() + token.lexeme.size() + 1);
+    }
+    int GetCount() const { return((int)types.size()); }
+    TOKENTYPE GetType(int i) const { return((TOKENTYPE)types[i]); }
+    const char* GetLexeme(int i) const { return(&lexemes[lexemeOffsets[i]]); }
+    int GetLexemeLength(int i) const { return((int)lexemeLengths[i]); }
+    int GetSymbol(int i) const { return(symbols[i]); }
+    void SetSymbol(int i, int symbol) { symbols[i] = symbol; }
+    int GetSourceLineNumber(int i) const { return(sourceLineNumbers[i]); }
+    int GetSourceLineIndex(int i) const { return(sourceLineIndexes[i]); }
+    //-----------------------------------------------------------
+    void Append(const TOKENBUFFER& tokenBuffer, int count, int sourceLineNumberOffset)
+    //-----------------------------------------------------------
+    {
+        // Append tokenBuffer's first count tokens, renumbering their source lines
+        const unsigned int lexemeOffset = (unsigned int)lexemes.size();
+        const int first = (int)types.size();
+        const size_t lexemeCharacters = (count == tokenBuffer.GetCount()) ? tokenBuffer.lexemes.size()
+            : (size_t)tokenBuffer.lexemeOffsets[count];
+
+        types.insert(types.end(), tokenBuffer.types.begin(), tokenBuffer.types.begin() + count);
+        lexemeOffsets.insert(lexemeOffsets.end(), tokenBuffer.lexemeOffsets.begin(), tokenBuffer.lexemeOffsets.begin() + count);
+        lexemeLengths.insert(lexemeLengths.end(), tokenBuffer.lexemeLengths.begin(), tokenBuffer.lexemeLengths.begin() + count);
+        symbols.insert(symbols.end(), tokenBuffer.symbols.begin(), tokenBuffer.symbols.begin() + count);
+        sourceLineNumbers.insert(sourceLineNumbers.end(), tokenBuffer.sourceLineNumbers.begin(), tokenBuffer.sourceLineNumbers.begin() + count);
+        sourceLineIndexes.insert(sourceLineIndexes.end(), tokenBuffer.sourceLineIndexes.begin(), tokenBuffer.sourceLineIndexes.begin() + count);
+        lexemes.insert(lexemes.end(), tokenBuffer.lexemes.begin(), tokenBuffer.lexemes.begin() + lexemeCharacters);
+        for (int i = first; i <= (int)types.size() - 1; i++)
+        {
+            lexemeOffsets[i] += lexemeOffset;
+            sourceLineNumbers[i] += sourceLineNumberOffset;
+        }
+    }
+};
+
+//===========================================================
+class TOKENCURSOR
+    //===========================================================
+{
+    /*
+       The parser's look-ahead window over a TOKENBUFFER. tokens[i] is built from
+          the buffer's arrays on each use and has the same members as a TOKEN, with
+          a read-only lexeme. Past the end of the buffer the final EOPTOKEN repeats.
+    */
+public:
+    struct LEXEME
+    {
+        const char* characters;
+        int length;
+
+        const char* c_str() const { return(characters); }
+        size_t size() const { return((size_t)length); }
+    };
+    struct TOKENVIEW
+    {
+        TOKENTYPE type;
+        LEXEME lexeme;
+        int symbol;
+        int sourceLineNumber;
+        int sourceLineIndex;
+    };
+
+private:
+    const TOKENBUFFER* tokenBuffer;
+    int position;
+
+public:
+    TOKENCURSOR()
+    {
+        tokenBuffer = NULL;
+        position = 0;
+    }
+    void SetTokenBuffer(const TOKENBUFFER* tokenBuffer)
+    {
+        this->tokenBuffer = tokenBuffer;
+        position = 0;
+    }
+    int GetPosition() const
+    {
+        return(position);
+    }
+    int GetCount() const
+    {
+        return(tokenBuffer->GetCount());
+    }
+    void Advance()
+    {
+        position++;
+    }
+    TOKENVIEW operator[](int i) const
+    {
+        const int last = tokenBuffer->GetCount() - 1;
+        const int k = (position + i <= last) ? position + i : last;
+        TOKENVIEW token = { tokenBuffer->GetType(k),
+            { tokenBuffer->GetLexeme(k), tokenBuffer->GetLexemeLength(k) }, tokenBuffer->GetSymbol(k),
+            tokenBuffer->GetSourceLineNumber(k), tokenBuffer->GetSourceLineIndex(k) };
+
+        return(token);
+    }
+};
+
+//-----------------------------------------------------------
+struct SCANCONTEXT
+//-----------------------------------------------------------
+{
+    // What GetNextToken() scans: the whole source program or one chunk of it
+    READER<CALLBACKSUSED, LOOKAHEAD>* reader;
+    IDENTIFIERINTERNER* interner;   // NULL leaves IDENTIFIER symbols 0 (chunks are interned when stitched)
+    int EOPTOKENs;        // EOPTOKENs returned so far
+    bool isChunk;         // lexical errors throw without being reported (see ScanSourceInParallel())
+};
+
+//-----------------------------------------------------------
+// The Parse* functions see TOKENWINDOW; with PRETOKENIZEDSOURCE it walks a TOKENBUFFER
+//-----------------------------------------------------------
+#ifdef PRETOKENIZEDSOURCE
+typedef TOKENCURSOR TOKENWINDOW;
+#else
+typedef SCANNEDTOKENWINDOW TOKENWINDOW;
+#endif
+
 //-----------------------------------------------------------
 // NEW: Structure to track global variable initialization
 //-----------------------------------------------------------
@@ -219,11 +619,15 @@ struct GLOBALINIT
 //--------------------------------------------------
 // Global variables
 //--------------------------------------------------
-READER<CALLBACKSUSED> reader(SOURCELINELENGTH, LOOKAHEAD);
+READER<CALLBACKSUSED, LOOKAHEAD> reader(SOURCELINELENGTH);
+IDENTIFIERINTERNER interner;
+SCANCONTEXT scanContext = { &reader, &interner, 0, false };
 LISTER lister(LINESPERPAGE);
+TRACER tracer;
+STATISTICS statistics;
 // CODEGENERATION
 CODE code;
-IDENTIFIERTABLE identifierTable(&lister, MAXIMUMIDENTIFIERS);
+IDENTIFIERTABLE identifierTable(&lister, &interner, INITIALIDENTIFIERS);
 // ENDCODEGENERATION
 
 // NEW: Global flag for checked arithmetic
@@ -232,34 +636,37 @@ bool checkedArithmetic = true;
 // NEW: Track global variable initializations
 vector<GLOBALINIT> globalInitializations;
 
-#ifdef TRACEPARSER
 int level;
-#endif
 
 //-----------------------------------------------------------
-void EnterModule(const char module[])
+void FormatModuleEvent(const TRACEEVENT& event, char information[])
 //-----------------------------------------------------------
 {
-#ifdef TRACEPARSER
-    char information[SOURCELINELENGTH + 1];
+    // context = module name, values[] = { level, isEnter }
+    sprintf(information, "   %*s%c%s", event.values[0] * 2, " ", (event.values[1] ? '>' : '<'),
+        (const char*)event.context);
+}
 
-    level++;
-    sprintf(information, "   %*s>%s", level * 2, " ", module);
-    lister.ListInformationLine(information);
-#endif
+//-----------------------------------------------------------
+void EnterModule(const char module[])
+//-----------------------------------------------------------
+{
+    if (tracer.IsON(TRACER::PARSERTRACE))
+    {
+        level++;
+        tracer.Log(FormatModuleEvent, module, level, true);
+    }
 }
 
 //-----------------------------------------------------------
 void ExitModule(const char module[])
 //-----------------------------------------------------------
 {
-#ifdef TRACEPARSER
-    char information[SOURCELINELENGTH + 1];
-
-    sprintf(information, "   %*s<%s", level * 2, " ", module);
-    lister.ListInformationLine(information);
-    level--;
-#endif
+    if (tracer.IsON(TRACER::PARSERTRACE))
+    {
+        tracer.Log(FormatModuleEvent, module, level, false);
+        level--;
+    }
 }
 
 //--------------------------------------------------
@@ -270,80 +677,162 @@ void ProcessCompilerError(int sourceLineNumber, int sourceLineIndex, const char
 
     // Use "panic mode" error recovery technique: report error message and terminate compilation!
     sprintf(information, "     At (%4d:%3d) %s", sourceLineNumber, sourceLineIndex, errorMessage);
+    lister.RebuildListing();
     lister.ListInformationLine(information);
     lister.ListInformationLine("AGL compiler ending with compiler error!\n");
+    lister.Flush();
     throw(AGLEXCEPTION("AGL compiler ending with compiler error!"));
 }
 
+#ifndef AGLBENCHMARK
+//-----------------------------------------------------------
+// (AGLBenchmark.cpp includes this file with AGLBENCHMARK defined to use its own main())
 //-----------------------------------------------------------
 int main()
 //-----------------------------------------------------------
 {
-    void Callback1(int sourceLineNumber, const char sourceLine[]);
-    void Callback2(int sourceLineNumber, const char sourceLine[]);
-    void ParseAegielProgram(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    bool CompileSourceFile(const char sourceFileName[]);
 
     char sourceFileName[80 + 1];
-    TOKEN tokens[LOOKAHEAD + 1];
 
     cout << "Source filename? "; cin >> sourceFileName;
 
+    // For example, AGLTRACE=SCANNER,IDENTIFIERTABLE (or ALL); events are listed at the end of the listing
+    if (getenv("AGLTRACE") != NULL)
+        tracer.SetCategoriesON(TRACER::ParseCategories(getenv("AGLTRACE")));
+    // AGLTIMEREPORT=TEXT (or JSON) reports where compile time went (and what was done) on stderr
+    if (getenv("AGLTIMEREPORT") != NULL)
+        statistics.SetON();
+
+    CompileSourceFile(sourceFileName);
+    cout << "AGL compiler ending\n";
+    if (statistics.IsON())
+    {
+        statistics.AddOutputFile(lister.GetListFileName(), lister.GetBytesWritten());
+        statistics.AddOutputFile(code.GetCodeFileName(), code.GetBytesWritten());
+        statistics.Report(cerr, STATISTICS::IsJSONFormat(getenv("AGLTIMEREPORT")));
+    }
+
+    system("PAUSE");
+    return(0);
+}
+#endif
+
+//-----------------------------------------------------------
+bool CompileSourceFile(const char sourceFileName[])
+//-----------------------------------------------------------
+{
+    /*
+       The whole compile of sourceFileName (.agl) into its .list and .stm files;
+          returns false when compilation ended with an error. It uses the global
+          reader, lister, code, and identifierTable, so it can only be called once
+          per run of the program.
+    */
+    bool isCompiled = true;
+    void Callback1(const SOURCELINEBATCH& batch);
+    void Callback2(int sourceLineNumber, const char sourceLine[], int sourceLineLength);
+    void ParseAegielProgram(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
+    void ScanSource(TOKENBUFFER& tokenBuffer);
+    void ScanSourceInParallel(TOKENBUFFER& tokenBuffer, const char sourceFileName[], int chunkSize = 1024 * 1024);
+
+    TOKENWINDOW tokens;
+#ifdef PRETOKENIZEDSOURCE
+    TOKENBUFFER tokenBuffer;
+#endif
+
     try
     {
+#ifdef BACKGROUNDLISTER
+        lister.SetBackgroundWriterON();
+#endif
+#ifdef LISTINGONERRORONLY
+        lister.SetListingOnErrorON();
+#endif
         lister.OpenFile(sourceFileName);
         code.OpenFile(sourceFileName);
+#ifdef LITERALPOOL
+        code.SetLiteralPoolON();
+#endif
 
         // CODEGENERATION
         code.EmitBeginningCode(sourceFileName);
         // ENDCODEGENERATION
 
         reader.SetLister(&lister);
-        reader.AddCallbackFunction(Callback1);
+        reader.SetTracer(&tracer);
+        identifierTable.SetTracer(&tracer);
+        reader.SetStatistics(&statistics);
+        identifierTable.SetStatistics(&statistics);
+        code.SetStatistics(&statistics);
+#ifdef MAPPEDSOURCEREADER
+        reader.SetMappedSourceON();
+#endif
+        reader.AddAsynchronousCallbackFunction(Callback1);
         reader.AddCallbackFunction(Callback2);
         reader.OpenFile(sourceFileName);
 
+#ifdef PRETOKENIZEDSOURCE
+        // Scan the whole source program before parsing it
+        {
+            STATISTICS::TIMER timer(&statistics, STATISTICS::SCANNERPHASE);
+
+#ifdef PARALLELSCANNER
+            ScanSourceInParallel(tokenBuffer, sourceFileName);
+#else
+            ScanSource(tokenBuffer);
+#endif
+        }
+        tokens.SetTokenBuffer(&tokenBuffer);
+#else
         // Fill tokens[] for look-ahead
         for (int i = 0; i <= LOOKAHEAD; i++)
             GetNextToken(tokens);
+#endif
 
-#ifdef TRACEPARSER
         level = 0;
-#endif
 
-        ParseAegielProgram(tokens);
+        {
+            // The recursive descent itself is whatever the phases it calls on do not account for
+            STATISTICS::TIMER timer(&statistics, STATISTICS::PARSERPHASE);
+
+            ParseAegielProgram(tokens);
+        }
 
         // CODEGENERATION
         code.EmitEndingCode();
         // ENDCODEGENERATION
 
+        reader.FlushAsynchronousCallbacks();
     }
     catch (AGLEXCEPTION aglException)
     {
+        reader.FlushAsynchronousCallbacks();
+        lister.RebuildListing();
+        code.Flush();
         cout << "AGL exception: " << aglException.GetDescription() << endl;
+        isCompiled = false;
     }
+    tracer.Dump(&lister);
     lister.ListInformationLine("******* AGL compiler ending");
-    cout << "AGL compiler ending\n";
-
-    system("PAUSE");
-    return(0);
+    lister.Flush();
+    return(isCompiled);
 }
 
 //-----------------------------------------------------------
-void ParseAegielProgram(TOKEN tokens[])
+void ParseAegielProgram(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope);
-    void ParseMAINDefinition(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseDataDefinitions(TOKENWINDOW& tokens, IDENTIFIERSCOPE identifierScope);
+    void ParseMAINDefinition(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     EnterModule("AegielProgram");
 
     ParseDataDefinitions(tokens, GLOBALSCOPE);
 
-#ifdef TRACECOMPILER
-    identifierTable.DisplayTableContents("Contents of identifier table after compilation of global data definitions");
-#endif
+    if (tracer.IsON(TRACER::COMPILERTRACE))
+        identifierTable.DisplayTableContents("Contents of identifier table after compilation of global data definitions");
 
     if (tokens[0].type == MAIN)
         ParseMAINDefinition(tokens);
@@ -359,11 +848,11 @@ void ParseAegielProgram(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
+void ParseDataDefinitions(TOKENWINDOW& tokens, IDENTIFIERSCOPE identifierScope)
 //-----------------------------------------------------------
 {
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     EnterModule("DataDefinitions");
 
@@ -372,6 +861,7 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
         do
         {
             char identifier[MAXIMUMLENGTHIDENTIFIER + 1];
+            int symbol;
             char reference[MAXIMUMLENGTHIDENTIFIER + 1];
             DATATYPE datatype;
             bool isInTable;
@@ -389,7 +879,8 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
 
             if (tokens[0].type != IDENTIFIER)
                 ProcessCompilerError(tokens[0].sourceLineNumber, tokens[0].sourceLineIndex, "Expecting identifier");
-            strcpy(identifier, tokens[0].lexeme);
+            strcpy(identifier, tokens[0].lexeme.c_str());
+            symbol = tokens[0].symbol;
             GetNextToken(tokens);
 
             if (tokens[0].type != COLON)
@@ -426,7 +917,7 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
                 {
                     // Simple case: direct integer literal
                     char initValue[SOURCELINELENGTH + 1];
-                    sprintf(initValue, "#0D%s", tokens[0].lexeme);
+                    sprintf(initValue, "#0D%s", tokens[0].lexeme.c_str());
 
                     GLOBALINIT gi;
                     strcpy(gi.initValue, initValue);
@@ -479,7 +970,7 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
             if (initDatatype != datatype)
                 ProcessCompilerError(tokens[0].sourceLineNumber, tokens[0].sourceLineIndex, "Initialization type mismatch");
 
-            index = identifierTable.GetIndex(identifier, isInTable);
+            index = identifierTable.GetIndex(symbol, isInTable);
             if (isInTable && identifierTable.IsInCurrentScope(index))
                 ProcessCompilerError(tokens[0].sourceLineNumber, tokens[0].sourceLineIndex, "Multiply-defined identifier");
 
@@ -500,14 +991,14 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
                     strcpy(globalInitializations.back().reference, reference);
                 }
                 // Don't emit POP here - will be done in PROGRAMBODY
-                identifierTable.AddToTable(identifier,
+                identifierTable.AddToTable(symbol,
                     isMutable ? GLOBAL_VARIABLE : GLOBAL_CONSTANT,
                     datatype, reference);
                 break;
             case PROGRAMMODULESCOPE:
                 code.AddRWToStaticData(1, comment, reference);
                 code.EmitFormattedLine("", "POP", reference);  // Store initialization value
-                identifierTable.AddToTable(identifier,
+                identifierTable.AddToTable(symbol,
                     isMutable ? PROGRAMMODULE_VARIABLE : PROGRAMMODULE_CONSTANT,
                     datatype, reference);
                 break;
@@ -525,12 +1016,12 @@ void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope)
 }
 
 //-----------------------------------------------------------
-void ParseMAINDefinition(TOKEN tokens[])
+void ParseMAINDefinition(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseDataDefinitions(TOKEN tokens[], IDENTIFIERSCOPE identifierScope);
-    void ParseStatement(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseDataDefinitions(TOKENWINDOW& tokens, IDENTIFIERSCOPE identifierScope);
+    void ParseStatement(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     char label[SOURCELINELENGTH + 1];
@@ -602,9 +1093,8 @@ void ParseMAINDefinition(TOKEN tokens[])
     code.EmitUnformattedLine("; **** =========");
     // ENDCODEGENERATION
 
-#ifdef TRACECOMPILER
-    identifierTable.DisplayTableContents("Contents of identifier table at end of compilation of MAIN module definition");
-#endif
+    if (tracer.IsON(TRACER::COMPILERTRACE))
+        identifierTable.DisplayTableContents("Contents of identifier table at end of compilation of MAIN module definition");
 
     identifierTable.ExitNestedStaticScope();
 
@@ -618,18 +1108,18 @@ void ParseMAINDefinition(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseStatement(TOKEN tokens[])
+void ParseStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseOUTPUTStatement(TOKEN tokens[]);
-    void ParseINVOKEStatement(TOKEN tokens[]);
-    void ParseAssignmentStatement(TOKEN tokens[]);
-    void ParseDECREEStatement(TOKEN tokens[]);
-    void ParseVIGILStatement(TOKEN tokens[]);
-    void ParseWHILSTStatement(TOKEN tokens[]);
-    void ParsePERSISTStatement(TOKEN tokens[]);
-    void ParseUNCHECKEDBlock(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseOUTPUTStatement(TOKENWINDOW& tokens);
+    void ParseINVOKEStatement(TOKENWINDOW& tokens);
+    void ParseAssignmentStatement(TOKENWINDOW& tokens);
+    void ParseDECREEStatement(TOKENWINDOW& tokens);
+    void ParseVIGILStatement(TOKENWINDOW& tokens);
+    void ParseWHILSTStatement(TOKENWINDOW& tokens);
+    void ParsePERSISTStatement(TOKENWINDOW& tokens);
+    void ParseUNCHECKEDBlock(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     EnterModule("Statement");
 
@@ -669,11 +1159,11 @@ void ParseStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseOUTPUTStatement(TOKEN tokens[])
+void ParseOUTPUTStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     DATATYPE datatype;
@@ -698,7 +1188,7 @@ void ParseOUTPUTStatement(TOKEN tokens[])
             // CODEGENERATION
             char reference[SOURCELINELENGTH + 1];
 
-            code.AddDSToStaticData(tokens[0].lexeme, "", reference);
+            code.AddDSToStaticData(tokens[0].lexeme.c_str(), "", reference);
             code.EmitFormattedLine("", "PUSHA", reference);
             code.EmitFormattedLine("", "SVC", "#SVC_WRITE_STRING");
             // ENDCODEGENERATION
@@ -743,11 +1233,11 @@ void ParseOUTPUTStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseINVOKEStatement(TOKEN tokens[])
+void ParseINVOKEStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseVariable(TOKENWINDOW& tokens, bool asLValue, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char reference[SOURCELINELENGTH + 1];
     char line[SOURCELINELENGTH + 1];
@@ -763,7 +1253,7 @@ void ParseINVOKEStatement(TOKEN tokens[])
     if (tokens[0].type == STRING)
     {
         // CODEGENERATION
-        code.AddDSToStaticData(tokens[0].lexeme, "", reference);
+        code.AddDSToStaticData(tokens[0].lexeme.c_str(), "", reference);
         code.EmitFormattedLine("", "PUSHA", reference);
         code.EmitFormattedLine("", "SVC", "#SVC_WRITE_STRING");
         // ENDCODEGENERATION
@@ -795,12 +1285,12 @@ void ParseINVOKEStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseAssignmentStatement(TOKEN tokens[])
+void ParseAssignmentStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE & datatype);
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseVariable(TOKENWINDOW& tokens, bool asLValue, DATATYPE & datatype);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     DATATYPE datatypeLHS, datatypeRHS;
@@ -854,12 +1344,12 @@ void ParseAssignmentStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseDECREEStatement(TOKEN tokens[])
+void ParseDECREEStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void ParseStatement(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void ParseStatement(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     char Ilabel[SOURCELINELENGTH + 1], Elabel[SOURCELINELENGTH + 1];
@@ -983,12 +1473,12 @@ void ParseDECREEStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseVIGILStatement(TOKEN tokens[])
+void ParseVIGILStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void ParseStatement(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void ParseStatement(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     char Dlabel[SOURCELINELENGTH + 1], Elabel[SOURCELINELENGTH + 1];
@@ -1065,12 +1555,12 @@ void ParseVIGILStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseWHILSTStatement(TOKEN tokens[])
+void ParseWHILSTStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void ParseStatement(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void ParseStatement(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     char Dlabel[SOURCELINELENGTH + 1], Elabel[SOURCELINELENGTH + 1];
@@ -1137,12 +1627,12 @@ void ParseWHILSTStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParsePERSISTStatement(TOKEN tokens[])
+void ParsePERSISTStatement(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void ParseStatement(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void ParseStatement(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
     char Dlabel[SOURCELINELENGTH + 1], Elabel[SOURCELINELENGTH + 1];
@@ -1206,11 +1696,11 @@ void ParsePERSISTStatement(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseUNCHECKEDBlock(TOKEN tokens[])
+void ParseUNCHECKEDBlock(TOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    void ParseStatement(TOKEN tokens[]);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseStatement(TOKENWINDOW& tokens);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     char line[SOURCELINELENGTH + 1];
 
@@ -1253,11 +1743,11 @@ void ParseUNCHECKEDBlock(TOKEN tokens[])
 }
 
 //-----------------------------------------------------------
-void ParseExpression(TOKEN tokens[], DATATYPE& datatype)
+void ParseExpression(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseConjunction(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseConjunction(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeLHS, datatypeRHS;
 
@@ -1308,11 +1798,11 @@ void ParseExpression(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseConjunction(TOKEN tokens[], DATATYPE& datatype)
+void ParseConjunction(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseNegation(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseNegation(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeLHS, datatypeRHS;
 
@@ -1355,11 +1845,11 @@ void ParseConjunction(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseNegation(TOKEN tokens[], DATATYPE& datatype)
+void ParseNegation(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseComparison(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseComparison(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeRHS;
 
@@ -1382,11 +1872,11 @@ void ParseNegation(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseComparison(TOKEN tokens[], DATATYPE& datatype)
+void ParseComparison(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseComparator(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseComparator(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeLHS, datatypeRHS;
 
@@ -1449,11 +1939,11 @@ void ParseComparison(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseComparator(TOKEN tokens[], DATATYPE& datatype)
+void ParseComparator(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseTerm(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseTerm(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeLHS, datatypeRHS;
 
@@ -1508,11 +1998,11 @@ void ParseComparator(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseTerm(TOKEN tokens[], DATATYPE& datatype)
+void ParseTerm(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseFactor(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseFactor(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeLHS, datatypeRHS;
 
@@ -1640,11 +2130,11 @@ void ParseTerm(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseFactor(TOKEN tokens[], DATATYPE& datatype)
+void ParseFactor(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseSecondary(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseSecondary(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     EnterModule("Factor");
 
@@ -1690,11 +2180,11 @@ void ParseFactor(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseSecondary(TOKEN tokens[], DATATYPE& datatype)
+void ParseSecondary(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParsePrimary(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParsePrimary(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     DATATYPE datatypeLHS, datatypeRHS;
 
@@ -1727,12 +2217,12 @@ void ParseSecondary(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParsePrimary(TOKEN tokens[], DATATYPE& datatype)
+void ParsePrimary(TOKENWINDOW& tokens, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE & datatype);
-    void ParseExpression(TOKEN tokens[], DATATYPE & datatype);
-    void GetNextToken(TOKEN tokens[]);
+    void ParseVariable(TOKENWINDOW& tokens, bool asLValue, DATATYPE & datatype);
+    void ParseExpression(TOKENWINDOW& tokens, DATATYPE & datatype);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     EnterModule("Primary");
 
@@ -1742,7 +2232,7 @@ void ParsePrimary(TOKEN tokens[], DATATYPE& datatype)
     {
         char operand[SOURCELINELENGTH + 1];
 
-        sprintf(operand, "#0D%s", tokens[0].lexeme);
+        sprintf(operand, "#0D%s", tokens[0].lexeme.c_str());
         code.EmitFormattedLine("", "PUSH", operand);
         datatype = INTTYPE;
         GetNextToken(tokens);
@@ -1778,10 +2268,10 @@ void ParsePrimary(TOKEN tokens[], DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE& datatype)
+void ParseVariable(TOKENWINDOW& tokens, bool asLValue, DATATYPE& datatype)
 //-----------------------------------------------------------
 {
-    void GetNextToken(TOKEN tokens[]);
+    void GetNextToken(TOKENWINDOW& tokens);
 
     bool isInTable;
     int index;
@@ -1792,7 +2282,7 @@ void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE& datatype)
     if (tokens[0].type != IDENTIFIER)
         ProcessCompilerError(tokens[0].sourceLineNumber, tokens[0].sourceLineIndex, "Expecting identifier");
 
-    index = identifierTable.GetIndex(tokens[0].lexeme, isInTable);
+    index = identifierTable.GetIndex(tokens[0].symbol, isInTable);
     if (!isInTable)
         ProcessCompilerError(tokens[0].sourceLineNumber, tokens[0].sourceLineIndex, "Undefined identifier");
 
@@ -1823,337 +2313,437 @@ void ParseVariable(TOKEN tokens[], bool asLValue, DATATYPE& datatype)
 }
 
 //-----------------------------------------------------------
-void Callback1(int sourceLineNumber, const char sourceLine[])
+void Callback1(const SOURCELINEBATCH& batch)
 //-----------------------------------------------------------
 {
-    cout << setw(4) << sourceLineNumber << " " << sourceLine << endl;
+    // Asynchronous: echo a whole batch of source lines with one console flush
+    for (int i = 0; i <= batch.GetCountOfSourceLines() - 1; i++)
+    {
+        int sourceLineLength;
+        const char* sourceLine = batch.GetSourceLine(i, sourceLineLength);
+
+        cout << setw(4) << batch.GetSourceLineNumber(i) << " ";
+        cout.write(sourceLine, sourceLineLength);
+        cout << '\n';
+    }
+    cout.flush();
 }
 
 //-----------------------------------------------------------
-void Callback2(int sourceLineNumber, const char sourceLine[])
+void Callback2(int sourceLineNumber, const char sourceLine[], int sourceLineLength)
 //-----------------------------------------------------------
 {
-    char line[SOURCELINELENGTH + 1];
-
-    sprintf(line, "; %4d %s", sourceLineNumber, sourceLine);
-    code.EmitUnformattedLine(line);
+    static string line;
+    char prefix[2 + 11 + 1 + 1];
+
+    // line is static so its storage grows to the longest source line and is then re-used
+    sprintf(prefix, "; %4d ", sourceLineNumber);
+    line.assign(prefix);
+    line.append(sourceLine, sourceLineLength);
+    code.SetSourceLineNumber(sourceLineNumber);
+    code.EmitUnformattedLine(line.c_str());
 }
 
 //-----------------------------------------------------------
-void GetNextToken(TOKEN tokens[])
+void GetNextToken(SCANNEDTOKENWINDOW& tokens)
 //-----------------------------------------------------------
 {
-    const char* TokenDescription(TOKENTYPE type);
+    void GetNextToken(SCANCONTEXT& context, SCANNEDTOKENWINDOW& tokens);
 
-    int i;
-    TOKENTYPE type;
-    char lexeme[SOURCELINELENGTH + 1];
-    int sourceLineNumber;
-    int sourceLineIndex;
-    char information[SOURCELINELENGTH + 1];
+    STATISTICS::TIMER timer(&statistics, STATISTICS::SCANNERPHASE);
 
-    for (int i = 1; i <= LOOKAHEAD; i++)
-        tokens[i - 1] = tokens[i];
+    GetNextToken(scanContext, tokens);
+    if (statistics.IsON()) statistics.Count(STATISTICS::TOKENS);
+}
 
-    char nextCharacter = reader.GetLookAheadCharacter(0).character;
+//-----------------------------------------------------------
+void ProcessScannerError(const SCANCONTEXT& context, int sourceLineNumber, int sourceLineIndex, const char errorMessage[])
+//-----------------------------------------------------------
+{
+    // A chunk has nowhere to report errors; ScanSourceInParallel() re-scans the source instead
+    if (context.isChunk)
+        throw(AGLEXCEPTION(errorMessage));
+    else
+        ProcessCompilerError(sourceLineNumber, sourceLineIndex, errorMessage);
+}
 
-    do
-    {
-        while ((nextCharacter == ' ')
-            || (nextCharacter == READER<CALLBACKSUSED>::EOLC)
-            || (nextCharacter == READER<CALLBACKSUSED>::TABC))
-            nextCharacter = reader.GetNextCharacter().character;
+//-----------------------------------------------------------
+void FormatCommentEvent(const TRACEEVENT& event, char information[])
+//-----------------------------------------------------------
+{
+    // values[] = { sourceLineNumber, sourceLineIndex }
+    sprintf(information, "At (%4d:%3d) begin line comment", event.values[0], event.values[1]);
+}
 
-        if ((nextCharacter == '/') && (reader.GetLookAheadCharacter(1).character == '/'))
-        {
-#ifdef TRACESCANNER
-            sprintf(information, "At (%4d:%3d) begin line comment",
-                reader.GetLookAheadCharacter(0).sourceLineNumber,
-                reader.GetLookAheadCharacter(0).sourceLineIndex);
-            lister.ListInformationLine(information);
-#endif
+//-----------------------------------------------------------
+void FormatTokenEvent(const TRACEEVENT& event, char information[])
+//-----------------------------------------------------------
+{
+    // values[] = { sourceLineNumber, sourceLineIndex, type, lexeme length }, text = lexeme (truncated)
+    const char* TokenDescription(TOKENTYPE type);
 
-            do
-                nextCharacter = reader.GetNextCharacter().character;
-            while ((nextCharacter != READER<CALLBACKSUSED>::EOLC)
-                && (nextCharacter != READER<CALLBACKSUSED>::EOPC));
-        }
-    } while ((nextCharacter == ' ')
-        || (nextCharacter == READER<CALLBACKSUSED>::EOLC)
-        || (nextCharacter == READER<CALLBACKSUSED>::TABC)
-        || ((nextCharacter == '/') && (reader.GetLookAheadCharacter(1).character == '/')));
+    sprintf(information, "At (%4d:%3d) token = %12s lexeme = |%s%s|",
+        event.values[0], event.values[1], TokenDescription((TOKENTYPE)event.values[2]),
+        event.text, ((event.values[3] > TRACETEXTLENGTH) ? "..." : ""));
+}
 
-    sourceLineNumber = reader.GetLookAheadCharacter(0).sourceLineNumber;
-    sourceLineIndex = reader.GetLookAheadCharacter(0).sourceLineIndex;
+//-----------------------------------------------------------
+void GetNextToken(SCANCONTEXT& context, SCANNEDTOKENWINDOW& tokens)
+//-----------------------------------------------------------
+{
 
-    if (isalpha(nextCharacter))
-    {
-        char UCLexeme[SOURCELINELENGTH + 1];
+    READER<CALLBACKSUSED, LOOKAHEAD>& reader = *context.reader;
 
-        i = 0;
-        lexeme[i++] = nextCharacter;
-        nextCharacter = reader.GetNextCharacter().character;
-        while (isalpha(nextCharacter) || isdigit(nextCharacter) || (nextCharacter == '_'))
-        {
-            lexeme[i++] = nextCharacter;
-            nextCharacter = reader.GetNextCharacter().character;
-        }
-        lexeme[i] = '\0';
-        for (i = 0; i <= (int)strlen(lexeme); i++)
-            UCLexeme[i] = toupper(lexeme[i]);
+    int i;
+    TOKENTYPE type;
+    int symbol = 0;
+    int sourceLineNumber;
+    int sourceLineIndex;
+    char information[SOURCELINELENGTH + 1];
 
-        bool isFound = false;
-        i = 0;
-        while (!isFound && (i <= (sizeof(TOKENTABLE) / sizeof(TOKENTABLERECORD)) - 1))
-        {
-            if (TOKENTABLE[i].isReservedWord && (strcmp(UCLexeme, TOKENTABLE[i].description) == 0))
-                isFound = true;
-            else
-                i++;
-        }
-        if (isFound)
-            type = TOKENTABLE[i].type;
-        else
-            type = IDENTIFIER;
-    }
-    else if (isdigit(nextCharacter))
+    // Slide the look-ahead "window"; the lexeme is built in-place so its (growable) storage is re-used
+    TOKEN& token = tokens.Advance();
+    string& lexeme = token.lexeme;
+
+    /*
+       Run the SCANNER automaton from STARTSTATE until it reaches an accept state.
+          Whenever the reader can hand over the rest of the current line, the
+          automaton runs over that span and the consumed characters are skipped
+          (and copied into the lexeme) in bulk; otherwise one character at a time.
+    */
+    int state = SCANNERTABLES::STARTSTATE;
+    int next;
+    char nextCharacter;
+
+    lexeme.clear();
+    sourceLineNumber = 0;
+    sourceLineIndex = 0;
+    do
     {
-        i = 0;
-        lexeme[i++] = nextCharacter;
-        nextCharacter = reader.GetNextCharacter().character;
-        while (isdigit(nextCharacter))
+        const char* span;
+        int n = reader.GetCharacterSpan(span);
+        const bool isSpan = (n > 0);
+        const NEXTCHARACTER& first = reader.GetLookAheadCharacter(0);
+        int j = 0;
+        int tokenStart = (state >= SCANNERTABLES::IDENTIFIERSTATE) ? 0 : -1;
+
+        nextCharacter = first.character;
+        if (!isSpan)
         {
-            lexeme[i++] = nextCharacter;
-            nextCharacter = reader.GetNextCharacter().character;
+            span = &nextCharacter;
+            n = 1;
         }
-        lexeme[i] = '\0';
-        type = INTEGER;
-    }
-    else
-    {
-        switch (nextCharacter)
+        next = state;
+        while (j < n)
         {
-        case '"':
-            i = 0;
-            nextCharacter = reader.GetNextCharacter().character;
-            while ((nextCharacter != '"')
-                && (nextCharacter != READER<CALLBACKSUSED>::EOLC)
-                && (nextCharacter != READER<CALLBACKSUSED>::EOPC))
+            // Skip the rest of a run of characters that leaves the state unchanged in bulk
+            if (isSpan)
             {
-                if (nextCharacter == '\\')
+                switch (state)
                 {
-                    lexeme[i++] = nextCharacter;
-                    nextCharacter = reader.GetNextCharacter().character;
-                    if ((nextCharacter == 'n') ||
-                        (nextCharacter == 't') ||
-                        (nextCharacter == 'b') ||
-                        (nextCharacter == 'r') ||
-                        (nextCharacter == '\\') ||
-                        (nextCharacter == '"'))
-                    {
-                        lexeme[i++] = nextCharacter;
-                    }
-                    else
-                        ProcessCompilerError(sourceLineNumber, sourceLineIndex,
-                            "Illegal escape character sequence in string literal");
+                case SCANNERTABLES::STARTSTATE:
+                    j += CHARACTERRUNS::SpaceRunLength(&span[j], n - j);
+                    break;
+                case SCANNERTABLES::COMMENTSTATE:
+                    // A comment ends at end-of-line (the end of span) or at an EOPC in the line
+                    j += CHARACTERRUNS::FindCharacter(&span[j], n - j, READER<CALLBACKSUSED, LOOKAHEAD>::EOPC);
+                    break;
+                case SCANNERTABLES::IDENTIFIERSTATE:
+                    j += CHARACTERRUNS::IdentifierRunLength(&span[j], n - j);
+                    break;
+                case SCANNERTABLES::INTEGERSTATE:
+                    j += CHARACTERRUNS::DigitRunLength(&span[j], n - j);
+                    break;
                 }
-                else
-                {
-                    lexeme[i++] = nextCharacter;
-                }
-                nextCharacter = reader.GetNextCharacter().character;
+                if (j == n) break;
             }
-            if (nextCharacter != '"')
-                ProcessCompilerError(sourceLineNumber, sourceLineIndex,
-                    "Un-terminated string literal");
-            lexeme[i] = '\0';
-            type = STRING;
-            reader.GetNextCharacter();
-            break;
-        case READER<CALLBACKSUSED>::EOPC:
-        {
-            static int count = 0;
-
-            if (++count > (LOOKAHEAD + 1))
-                ProcessCompilerError(sourceLineNumber, sourceLineIndex,
-                    "Unexpected end-of-program");
-            else
-            {
-                type = EOPTOKEN;
-                reader.GetNextCharacter();
-                lexeme[0] = '\0';
-            }
-        }
-        break;
-        case ',':
-            type = COMMA;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case ';':
-            type = SEMICOLON;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '{':
-            type = OBRACE;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '}':
-            type = CBRACE;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '(':
-            type = OPARENTHESIS;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case ')':
-            type = CPARENTHESIS;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case ':':
-            type = COLON;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '<':
-            lexeme[0] = nextCharacter;
-            nextCharacter = reader.GetNextCharacter().character;
-            if (nextCharacter == '=')
-            {
-                type = LTEQ;
-                lexeme[1] = nextCharacter; lexeme[2] = '\0';
-                reader.GetNextCharacter();
-            }
-            else if (nextCharacter == '-')
+            next = SCANNER.transitions[state][SCANNER.characterClasses[(unsigned char)span[j]]];
+            if (next >= SCANNERTABLES::FIRSTACCEPT) break;
+            if ((state == SCANNERTABLES::STARTSTATE) && (next != SCANNERTABLES::STARTSTATE))
             {
-                type = LEFTARROW;
-                lexeme[1] = nextCharacter; lexeme[2] = '\0';
-                reader.GetNextCharacter();
+                sourceLineNumber = first.sourceLineNumber;
+                sourceLineIndex = first.sourceLineIndex + j;
+                tokenStart = j;
             }
-            else
+            else if (next == SCANNERTABLES::COMMENTSTATE && state == SCANNERTABLES::SLASHSTATE)
             {
-                type = LT;
-                lexeme[1] = '\0';
+                if (tracer.IsON(TRACER::SCANNERTRACE))
+                    tracer.Log(FormatCommentEvent, NULL, sourceLineNumber, sourceLineIndex);
+                lexeme.clear();
+                tokenStart = -1;
             }
-            break;
-        case '=':
-            type = EQ;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '>':
-            lexeme[0] = nextCharacter;
-            nextCharacter = reader.GetNextCharacter().character;
-            if (nextCharacter == '=')
-            {
-                type = GTEQ;
-                lexeme[1] = nextCharacter; lexeme[2] = '\0';
-                reader.GetNextCharacter();
-            }
-            else
+            state = next;
+            j++;
+        }
+        if (next >= SCANNERTABLES::FIRSTACCEPT)
+        {
+            if (state == SCANNERTABLES::STARTSTATE)
             {
-                type = GT;
-                lexeme[1] = '\0';
+                sourceLineNumber = first.sourceLineNumber;
+                sourceLineIndex = first.sourceLineIndex + j;
+                tokenStart = j;
             }
-            break;
-        case '!':
-            lexeme[0] = nextCharacter;
-            if (reader.GetLookAheadCharacter(1).character == '=')
+            // Include the current character in the token when the accept state says so
+            if ((next - SCANNERTABLES::FIRSTACCEPT) % 2 == 1) j++;
+        }
+        if (tokenStart >= 0) lexeme.append(span + tokenStart, j - tokenStart);
+        if (j > 0)
+            nextCharacter = (isSpan ? reader.SkipCharacters(j) : reader.GetNextCharacter()).character;
+    } while (next < SCANNERTABLES::FIRSTACCEPT);
+
+    type = (TOKENTYPE)((next - SCANNERTABLES::FIRSTACCEPT) / 2);
+    switch (type)
+    {
+    case IDENTIFIER:
+        if ((int)lexeme.size() > MAXIMUMLENGTHIDENTIFIER)
+            ProcessScannerError(context, sourceLineNumber, sourceLineIndex, "Identifier too long");
+        i = RESERVEDWORDS.Find(lexeme.c_str(), (int)lexeme.size());
+        if (i != -1)
+            type = TOKENTABLE[i].type;
+        else if (context.interner != NULL)
+            symbol = context.interner->Intern(lexeme.c_str(), (int)lexeme.size());
+        break;
+    case INTEGER:
+        if ((int)lexeme.size() > MAXIMUMLENGTHINTEGER)
+            ProcessScannerError(context, sourceLineNumber, sourceLineIndex, "Integer literal too long");
+        break;
+    case STRING:
+        lexeme.clear();
+        nextCharacter = reader.GetNextCharacter().character;
+        while ((nextCharacter != '"')
+            && (nextCharacter != READER<CALLBACKSUSED, LOOKAHEAD>::EOLC)
+            && (nextCharacter != READER<CALLBACKSUSED, LOOKAHEAD>::EOPC))
+        {
+            if (nextCharacter == '\\')
             {
+                lexeme += nextCharacter;
                 nextCharacter = reader.GetNextCharacter().character;
-                lexeme[1] = nextCharacter; lexeme[2] = '\0';
-                reader.GetNextCharacter();
-                type = NOTEQ;
+                if ((nextCharacter == 'n') ||
+                    (nextCharacter == 't') ||
+                    (nextCharacter == 'b') ||
+                    (nextCharacter == 'r') ||
+                    (nextCharacter == '\\') ||
+                    (nextCharacter == '"'))
+                {
+                    lexeme += nextCharacter;
+                }
+                else
+                    ProcessScannerError(context, sourceLineNumber, sourceLineIndex,
+                        "Illegal escape character sequence in string literal");
             }
             else
             {
-                type = UNKTOKEN;
-                lexeme[1] = '\0';
-                reader.GetNextCharacter();
+                lexeme += nextCharacter;
             }
-            break;
-        case '+':
-            type = PLUS;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '-':
-            type = MINUS;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
+            nextCharacter = reader.GetNextCharacter().character;
+        }
+        if (nextCharacter != '"')
+            ProcessScannerError(context, sourceLineNumber, sourceLineIndex,
+                "Un-terminated string literal");
+        type = STRING;
+        reader.GetNextCharacter();
+        break;
+    case EOPTOKEN:
+        if (++context.EOPTOKENs > (LOOKAHEAD + 1))
+            ProcessScannerError(context, sourceLineNumber, sourceLineIndex,
+                "Unexpected end-of-program");
+        else
+        {
+            type = EOPTOKEN;
             reader.GetNextCharacter();
-            break;
-        case '*':
-            lexeme[0] = nextCharacter;
-            if (reader.GetLookAheadCharacter(1).character == '*')
+            lexeme.clear();
+        }
+        break;
+    default:
+        break;
+    }
+
+    token.type = type;
+    token.symbol = symbol;
+    token.sourceLineNumber = sourceLineNumber;
+    token.sourceLineIndex = sourceLineIndex;
+
+    if (tracer.IsON(TRACER::SCANNERTRACE))
+        tracer.Log(FormatTokenEvent, NULL, token.sourceLineNumber, token.sourceLineIndex,
+            type, (int)lexeme.size(), lexeme.c_str());
+}
+
+//-----------------------------------------------------------
+void ScanSource(TOKENBUFFER& tokenBuffer)
+//-----------------------------------------------------------
+{
+    // Scanner-only pass over the source program: every token through the first EOPTOKEN
+    void GetNextToken(SCANNEDTOKENWINDOW& tokens);
+
+    SCANNEDTOKENWINDOW tokens;
+
+    tokenBuffer.Reserve(reader.GetSourceSize());
+    do
+    {
+        GetNextToken(tokens);
+        tokenBuffer.Add(tokens[LOOKAHEAD]);
+    } while (tokens[LOOKAHEAD].type != EOPTOKEN);
+}
+
+//-----------------------------------------------------------
+void ScanSourceInParallel(TOKENBUFFER& tokenBuffer, const char sourceFileName[], int chunkSize)
+//-----------------------------------------------------------
+{
+    /*
+       Same result as ScanSource(), with the source program split into chunks of
+          about chunkSize characters that are scanned by a pool of threads. AGL tokens
+          (string literals and comments included) never continue past end-of-line,
+          so every line start is a safe chunk boundary. Each chunk is scanned with
+          its own READER from line 1, then the chunks' tokens are concatenated with
+          their source line numbers moved past the lines of the chunks before them.
+          When a chunk has a lexical error or contains an EOPC ('\0') the whole
+          source is scanned by ScanSource() instead, so errors are reported exactly
+          as they are sequentially.
+    */
+    void GetNextToken(SCANCONTEXT& context, SCANNEDTOKENWINDOW& tokens);
+    void ScanSource(TOKENBUFFER& tokenBuffer);
+
+    struct CHUNK
+    {
+        size_t begin;
+        size_t size;
+        int sourceLines;       // '\n'-terminated lines in chunk
+        bool isScanned;
+        TOKENBUFFER tokens;
+    };
+
+    // Trace events must be logged in source order
+    if (tracer.IsON(TRACER::READERTRACE | TRACER::SCANNERTRACE))
+    {
+        ScanSource(tokenBuffer);
+        return;
+    }
+
+    char fullFileName[80 + 1];
+    MAPPEDFILE SOURCE;
+    vector<CHUNK> chunks;
+    vector<thread> pool;
+    atomic<int> nextChunk(0);
+
+    strcpy(fullFileName, sourceFileName);
+    strcat(fullFileName, ".agl");
+    if (!SOURCE.Open(fullFileName)) throw(AGLEXCEPTION("Unable to open source file"));
+
+    const char* base = SOURCE.GetBase();
+    const size_t size = SOURCE.GetSize();
+
+    for (size_t begin = 0; begin < size; )
+    {
+        const char* EOL = (begin + chunkSize < size)
+            ? (const char*)memchr(base + begin + chunkSize - 1, '\n', size - (begin + chunkSize - 1)) : NULL;
+        CHUNK chunk;
+
+        chunk.begin = begin;
+        chunk.size = (EOL != NULL) ? (size_t)(EOL - base) + 1 - begin : size - begin;
+        chunk.sourceLines = 0;
+        chunk.isScanned = false;
+        chunks.push_back(chunk);
+        begin += chunk.size;
+    }
+    if (chunks.size() <= 1)
+    {
+        ScanSource(tokenBuffer);
+        return;
+    }
+
+    // Workers take the next unscanned chunk until there are none left
+    auto ScanChunks = [&]()
+    {
+        int k;
+
+        while ((k = nextChunk++) <= (int)chunks.size() - 1)
+        {
+            CHUNK& chunk = chunks[k];
+            const char* characters = base + chunk.begin;
+
+            for (const char* EOL = characters; (EOL = (const char*)memchr(EOL, '\n', characters + chunk.size - EOL)) != NULL; EOL++)
+                chunk.sourceLines++;
+            if (memchr(characters, '\0', chunk.size) != NULL) continue;
+            try
             {
-                nextCharacter = reader.GetNextCharacter().character;
-                lexeme[1] = nextCharacter; lexeme[2] = '\0';
-                type = POWER;
+                READER<CALLBACKSUSED, LOOKAHEAD> chunkReader(SOURCELINELENGTH);
+                SCANCONTEXT context = { &chunkReader, NULL, 0, true };
+                SCANNEDTOKENWINDOW tokens;
+
+                chunkReader.OpenMemory(characters, chunk.size);
+                chunk.tokens.Reserve((long long)chunk.size);
+                do
+                {
+                    GetNextToken(context, tokens);
+                    chunk.tokens.Add(tokens[LOOKAHEAD]);
+                } while (tokens[LOOKAHEAD].type != EOPTOKEN);
+                chunk.isScanned = true;
             }
-            else
+            catch (AGLEXCEPTION)
             {
-                type = MULTIPLY;
-                lexeme[0] = nextCharacter; lexeme[1] = '\0';
             }
-            reader.GetNextCharacter();
-            break;
-        case '/':
-            type = DIVIDE;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '%':
-            type = MODULUS;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        case '^':
-            type = POWER;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
-        default:
-            type = UNKTOKEN;
-            lexeme[0] = nextCharacter; lexeme[1] = '\0';
-            reader.GetNextCharacter();
-            break;
+        }
+    };
+    const int threads = (int)min((size_t)max(thread::hardware_concurrency(), 1U), chunks.size());
+
+    for (int i = 1; i <= threads - 1; i++)
+        pool.push_back(thread(ScanChunks));
+    ScanChunks();
+    for (size_t i = 0; i < pool.size(); i++)
+        pool[i].join();
+
+    for (size_t k = 0; k < chunks.size(); k++)
+    {
+        if (!chunks[k].isScanned)
+        {
+            ScanSource(tokenBuffer);
+            return;
         }
     }
 
-    tokens[LOOKAHEAD].type = type;
-    strcpy(tokens[LOOKAHEAD].lexeme, lexeme);
-    tokens[LOOKAHEAD].sourceLineNumber = sourceLineNumber;
-    tokens[LOOKAHEAD].sourceLineIndex = sourceLineIndex;
+    // Every chunk but the last ends with the EOPTOKEN for its own end
+    int sourceLineNumberOffset = 0;
 
-#ifdef TRACESCANNER
-    sprintf(information, "At (%4d:%3d) token = %12s lexeme = |%s|",
-        tokens[LOOKAHEAD].sourceLineNumber,
-        tokens[LOOKAHEAD].sourceLineIndex,
-        TokenDescription(type), lexeme);
-    lister.ListInformationLine(information);
-#endif
+    tokenBuffer.Reserve((long long)size);
+    for (size_t k = 0; k < chunks.size(); k++)
+    {
+        tokenBuffer.Append(chunks[k].tokens,
+            chunks[k].tokens.GetCount() - ((k == chunks.size() - 1) ? 0 : 1), sourceLineNumberOffset);
+        sourceLineNumberOffset += chunks[k].sourceLines;
+    }
+
+    // Intern in source order so symbols are numbered as ScanSource() numbers them
+    for (int i = 0; i <= tokenBuffer.GetCount() - 1; i++)
+        if (tokenBuffer.GetType(i) == IDENTIFIER)
+            tokenBuffer.SetSymbol(i, scanContext.interner->Intern(tokenBuffer.GetLexeme(i), tokenBuffer.GetLexemeLength(i)));
+    if (statistics.IsON()) statistics.Count(STATISTICS::TOKENS, tokenBuffer.GetCount());
+
+    // List the source lines (and give them to the callback functions) as ScanSource() does
+    scanContext.reader->ReadRemainingSourceLines();
 }
 
 //-----------------------------------------------------------
-const char* TokenDescription(TOKENTYPE type)
+void GetNextToken(TOKENCURSOR& tokens)
 //-----------------------------------------------------------
 {
-    int i;
-    bool isFound;
+    /*
+       Parser-side GetNextToken() when the source has been pre-tokenized. Moving
+          past the end-of-program token raises the same error GetNextToken() raises
+          after the LOOKAHEAD+1-th EOPTOKEN.
+    */
+    tokens.Advance();
+    if (tokens.GetPosition() >= tokens.GetCount())
+        ProcessCompilerError(tokens[0].sourceLineNumber, tokens[0].sourceLineIndex,
+            "Unexpected end-of-program");
+}
 
-    isFound = false;
-    i = 0;
-    while (!isFound && (i <= (sizeof(TOKENTABLE) / sizeof(TOKENTABLERECORD)) - 1))
-    {
-        if (TOKENTABLE[i].type == type)
-            isFound = true;
-        else
-            i++;
-    }
-    return (isFound ? TOKENTABLE[i].description : "???????");
+//-----------------------------------------------------------
+const char* TokenDescription(TOKENTYPE type)
+//-----------------------------------------------------------
+{
+    // TOKENTABLE[] is in TOKENTYPE order (see IsTOKENTABLEInTOKENTYPEOrder())
+    if ((0 <= (int)type) && ((int)type <= (int)(sizeof(TOKENTABLE) / sizeof(TOKENTABLERECORD)) - 1))
+        return(TOKENTABLE[type].description);
+    else
+        return("???????");
 }
\ No newline at end of file
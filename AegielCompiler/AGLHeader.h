@@ -1,18 +1,45 @@
 //-----------------------------------------------------------
 // Izak De La Cruz
 // AGL compiler "global" definitions and the common classes
-//    AGLEXCEPTION, LISTER, READER, CODE, and IDENTIFIERTABLE
+//    AGLEXCEPTION, RECORDQUEUE, LISTER, TRACER, STATISTICS, MAPPEDFILE,
+//    LOOKAHEADWINDOW, SOURCELINEQUEUE, CHARACTERRUNS, READER, CODE,
+//    IDENTIFIERINTERNER, and IDENTIFIERTABLE
 //
 // AGL.h
 //-----------------------------------------------------------
 #define _CRT_SECURE_NO_WARNINGS 
 #define CALLBACKSUSED 2
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// SIMDSCANNER (AGLCompiler.cpp) selects the widest character-run kernels the target allows
+#if defined(SIMDSCANNER) && defined(__AVX2__)
+#define SIMDAVX2
+#include <immintrin.h>
+#elif defined(SIMDSCANNER) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define SIMDSSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(SIMDAVX2) || defined(SIMDSSE2))
+#include <intrin.h>
+#endif
+
 const int SOURCELINELENGTH = 512;
 const int LOOKAHEAD = 2;
 const int LINESPERPAGE = 60;
 const int MAXIMUMLENGTHIDENTIFIER = 64;
-const int MAXIMUMIDENTIFIERS = 500;
+const int MAXIMUMLENGTHINTEGER = 32;
+const int INITIALIDENTIFIERS = 500;
+const int TRACETEXTLENGTH = 31;
 
 enum DATATYPE
 {
@@ -80,27 +107,217 @@ public:
     }
 };
 
+//===========================================================
+class RECORDQUEUE
+    //===========================================================
+{
+    /*
+       Lock-free single-producer/single-consumer queue of variable-length records,
+          each a RECORDHEADER followed by length characters, stored in a ring of
+          CAPACITY bytes. head (consumer) and tail (producer) only ever increase;
+          a record never wraps--when it does not fit before the end of the ring a
+          WRAP marker sends both sides back to the start. The producer yields while
+          the ring is full.
+    */
+public:
+    struct RECORDHEADER
+    {
+        int kind;
+        int number;
+        int length;
+        int isLastPiece;
+    };
+    static const int WRAP = -1;
+    static const int CAPACITY = 1 << 20;
+    static const int MAXIMUMPIECELENGTH = CAPACITY / 4;
+
+private:
+    char* ring;
+    atomic<size_t> head;
+    atomic<size_t> tail;
+    size_t nextHead;
+
+public:
+    RECORDQUEUE();
+    ~RECORDQUEUE();
+    void Push(int kind, int number, const char text[], int length, bool isLastPiece);
+    bool Pop(RECORDHEADER& header, const char*& text);
+    void Release();
+
+private:
+    static size_t RecordSize(int length)
+    {
+        // Records are kept 16-byte aligned
+        return((sizeof(RECORDHEADER) + (size_t)length + 15) & ~(size_t)15);
+    }
+};
+
+//-----------------------------------------------------------
+RECORDQUEUE::RECORDQUEUE()
+//-----------------------------------------------------------
+{
+    ring = new char[CAPACITY];
+    head = 0;
+    tail = 0;
+    nextHead = 0;
+}
+
+//-----------------------------------------------------------
+RECORDQUEUE::~RECORDQUEUE()
+//-----------------------------------------------------------
+{
+    delete[] ring;
+}
+
+//-----------------------------------------------------------
+void RECORDQUEUE::Push(int kind, int number, const char text[], int length, bool isLastPiece)
+//-----------------------------------------------------------
+{
+    // Producer only; length <= MAXIMUMPIECELENGTH
+    const size_t size = RecordSize(length);
+    size_t position = tail.load(memory_order_relaxed);
+    size_t toEnd = CAPACITY - (position % CAPACITY);
+    size_t needed = (toEnd < size) ? toEnd + size : size;
+    RECORDHEADER header;
+
+    while (CAPACITY - (position - head.load(memory_order_acquire)) < needed)
+        this_thread::yield();
+    if (toEnd < size)
+    {
+        header.kind = WRAP;
+        memcpy(&ring[position % CAPACITY], &header, sizeof(header));
+        position += toEnd;
+    }
+    header.kind = kind;
+    header.number = number;
+    header.length = length;
+    header.isLastPiece = isLastPiece ? 1 : 0;
+    memcpy(&ring[position % CAPACITY], &header, sizeof(header));
+    memcpy(&ring[position % CAPACITY + sizeof(header)], text, length);
+    tail.store(position + size, memory_order_release);
+}
+
+//-----------------------------------------------------------
+bool RECORDQUEUE::Pop(RECORDHEADER& header, const char*& text)
+//-----------------------------------------------------------
+{
+    // Consumer only; text remains valid until Release()
+    size_t position = head.load(memory_order_relaxed);
+
+    while (true)
+    {
+        if (position == tail.load(memory_order_acquire)) return(false);
+        memcpy(&header, &ring[position % CAPACITY], sizeof(header));
+        if (header.kind != WRAP) break;
+        position += CAPACITY - (position % CAPACITY);
+        head.store(position, memory_order_release);
+    }
+    text = &ring[position % CAPACITY + sizeof(header)];
+    nextHead = position + RecordSize(header.length);
+    return(true);
+}
+
+//-----------------------------------------------------------
+void RECORDQUEUE::Release()
+//-----------------------------------------------------------
+{
+    head.store(nextHead, memory_order_release);
+}
+
 //===========================================================
 class LISTER
     //===========================================================
 {
+    /*
+       Listing lines are formatted into a large user-space buffer instead of being
+          written with endl (which flushed the list file once per line). The buffer
+          is written out only at a page boundary (once it is at least half full),
+          when it fills, on Flush() (compiler errors), and at exit.
+
+       When the background writer is ON, ListSourceLine()/ListInformationLine() only
+          copy raw records (line number and text) into a lock-free RECORDQUEUE, and a
+          dedicated writer thread applies the page layout and does all file output.
+          The .list file is byte-identical either way.
+
+       When listing-on-error is ON, nothing is written during compilation. READER
+          calls IndexSourceLine() instead of ListSourceLine(), recording only the
+          4-byte file offset of each source line, and information (trace) lines are
+          discarded. RebuildListing() (called on a compiler error) creates the .list
+          file and lists every source line read so far from that index; listing then
+          continues normally. Successful compilations produce no .list file.
+    */
 private:
+    static const int BUFFERSIZE = 64 * 1024;
+    enum RECORDKIND { SOURCELINE, INFORMATIONLINE, FLUSH, STOP };
+
     const int LINESPERPAGE;
 
     ofstream LIST;
     int pageNumber;
     int linesOnPage;
     char sourceFileName[80 + 1];
+    char* buffer;
+    int bufferLength;
+    long long bytesWritten;
+    //--------------------------------------------------
+    // background writer
+    //--------------------------------------------------
+    bool backgroundWriterON;
+    RECORDQUEUE* records;
+    thread writer;
+    int flushesRequested;
+    atomic<int> flushesCompleted;
+    //--------------------------------------------------
+    // listing-on-error
+    //--------------------------------------------------
+    bool listingOnErrorON;
+    char listFileName[80 + 1];
+    vector<unsigned int> sourceLineOffsets;
 
 public:
     LISTER(const int LINESPERPAGE = 55);
     ~LISTER();
     void OpenFile(const char sourceFileName[]);
-    void ListSourceLine(int sourceLineNumber, const char sourceLine[]);
+    void ListSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength);
     void ListInformationLine(const char information[]);
+    void Flush();
+    void SetBackgroundWriterON(const bool setting = true)
+    {
+        this->backgroundWriterON = setting;
+    }
+    bool GetBackgroundWriterON()
+    {
+        return(this->backgroundWriterON);
+    }
+    void SetListingOnErrorON(const bool setting = true)
+    {
+        this->listingOnErrorON = setting;
+    }
+    bool GetListingOnErrorON()
+    {
+        return(this->listingOnErrorON);
+    }
+    void IndexSourceLine(int sourceLineNumber, long long sourceLineOffset);
+    void RebuildListing();
+    const char* GetListFileName()
+    {
+        return(this->listFileName);
+    }
+    long long GetBytesWritten()
+    {
+        // Exact after Flush() (the background writer may still be writing otherwise)
+        return(this->bytesWritten);
+    }
 
 private:
+    void FormatSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength, bool isLineStart, bool isLineEnd);
+    void FormatInformationLine(const char information[], int length, bool isLineStart, bool isLineEnd);
+    void WriteBuffer();
     void ListTopOfPageHeader();
+    void Append(const char characters[], int length);
+    void AppendInteger(int integer, int width);
+    void PushRecord(RECORDKIND kind, int number, const char text[], int length);
+    void WriteRecords();
 };
 
 //-----------------------------------------------------------
@@ -109,58 +326,198 @@ LISTER::LISTER(const int LINESPERPAGE) : LINESPERPAGE(LINESPERPAGE)
 {
     pageNumber = 0;
     linesOnPage = 0;
+    buffer = new char[BUFFERSIZE];
+    bufferLength = 0;
+    bytesWritten = 0;
+    listFileName[0] = '\0';
+    backgroundWriterON = false;
+    records = NULL;
+    flushesRequested = 0;
+    flushesCompleted = 0;
+    listingOnErrorON = false;
 }
 
 //-----------------------------------------------------------
 LISTER::~LISTER()
 //-----------------------------------------------------------
 {
+    if (writer.joinable())
+    {
+        PushRecord(STOP, 0, "", 0);
+        writer.join();
+    }
     if (LIST.is_open())
     {
-        LIST.flush();
+        WriteBuffer();
         LIST.close();
     }
+    delete records;
+    delete[] buffer;
 }
 
 //-----------------------------------------------------------
 void LISTER::OpenFile(const char sourceFileName[])
 //-----------------------------------------------------------
 {
-    char fullFileName[80 + 1];
-
     strcpy(this->sourceFileName, sourceFileName);
     strcat(this->sourceFileName, ".agl");
-    strcpy(fullFileName, sourceFileName);
-    strcat(fullFileName, ".list");
-    LIST.open(fullFileName, ios::out);
+    strcpy(listFileName, sourceFileName);
+    strcat(listFileName, ".list");
+    if (listingOnErrorON)
+    {
+        // Do not leave a stale listing (or source line index) from an earlier compilation behind
+        remove(listFileName);
+        sourceLineOffsets.clear();
+        return;
+    }
+    LIST.open(listFileName, ios::out);
     if (!LIST.is_open()) throw(AGLEXCEPTION("Unable to open list file"));
     ListTopOfPageHeader();
+    if (backgroundWriterON)
+    {
+        records = new RECORDQUEUE;
+        writer = thread(&LISTER::WriteRecords, this);
+    }
+}
+
+//-----------------------------------------------------------
+void LISTER::ListSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength)
+//-----------------------------------------------------------
+{
+    /*
+       sourceLine is *NOT* necessarily '\0'-terminated (it may be a view into a
+          memory-mapped source file), so exactly sourceLineLength characters are listed
+    */
+    if (writer.joinable())
+        PushRecord(SOURCELINE, sourceLineNumber, sourceLine, sourceLineLength);
+    else
+        FormatSourceLine(sourceLineNumber, sourceLine, sourceLineLength, true, true);
+}
+
+//-----------------------------------------------------------
+void LISTER::ListInformationLine(const char information[])
+//-----------------------------------------------------------
+{
+    if (listingOnErrorON) return;
+    if (writer.joinable())
+        PushRecord(INFORMATIONLINE, 0, information, (int)strlen(information));
+    else
+        FormatInformationLine(information, (int)strlen(information), true, true);
 }
 
 //-----------------------------------------------------------
-void LISTER::ListSourceLine(int sourceLineNumber, const char sourceLine[])
+void LISTER::Flush()
 //-----------------------------------------------------------
 {
-    if (linesOnPage >= LINESPERPAGE)
+    // With the background writer, wait until it has written everything listed so far
+    if (writer.joinable())
     {
-        ListTopOfPageHeader();
-        linesOnPage = 0;
+        PushRecord(FLUSH, ++flushesRequested, "", 0);
+        while (flushesCompleted.load(memory_order_acquire) < flushesRequested)
+            this_thread::yield();
     }
-    LIST << setw(4) << sourceLineNumber << " " << sourceLine << endl;
-    linesOnPage++;
+    else if (LIST.is_open())
+        WriteBuffer();
 }
 
 //-----------------------------------------------------------
-void LISTER::ListInformationLine(const char information[])
+void LISTER::IndexSourceLine(int sourceLineNumber, long long sourceLineOffset)
+//-----------------------------------------------------------
+{
+    // Source lines are numbered 1, 2, ... so sourceLineOffsets[sourceLineNumber-1] is the offset
+    if (sourceLineNumber != (int)sourceLineOffsets.size() + 1)
+        throw(AGLEXCEPTION("Source lines must be indexed in order for listing-on-error"));
+    if (sourceLineOffset > 0XFFFFFFFFLL)
+        throw(AGLEXCEPTION("Source file too large to index for listing-on-error"));
+    sourceLineOffsets.push_back((unsigned int)sourceLineOffset);
+}
+
+//-----------------------------------------------------------
+void LISTER::RebuildListing()
+//-----------------------------------------------------------
+{
+    /*
+       Source lines are re-read from the source file and trimmed exactly as READER
+          trims them, so the rebuilt source lines match an ordinary listing
+    */
+    ifstream SOURCE;
+    string sourceLine;
+
+    if (!listingOnErrorON) return;
+    listingOnErrorON = false;
+    LIST.open(listFileName, ios::out);
+    if (!LIST.is_open()) throw(AGLEXCEPTION("Unable to open list file"));
+    ListTopOfPageHeader();
+    SOURCE.open(sourceFileName, ios::in | ios::binary);
+    if (!SOURCE.is_open()) throw(AGLEXCEPTION("Unable to open source file"));
+    for (int i = 0; i <= (int)sourceLineOffsets.size() - 1; i++)
+    {
+        int sourceLineLength;
+
+        SOURCE.clear();
+        SOURCE.seekg(sourceLineOffsets[i]);
+        getline(SOURCE, sourceLine);
+        sourceLineLength = (int)sourceLine.size();
+        while ((0 <= sourceLineLength - 1) && iscntrl(sourceLine[sourceLineLength - 1]))
+            sourceLineLength--;
+        FormatSourceLine(i + 1, sourceLine.c_str(), sourceLineLength, true, true);
+    }
+    SOURCE.close();
+    vector<unsigned int>().swap(sourceLineOffsets);
+}
+
+//-----------------------------------------------------------
+void LISTER::FormatSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength,
+    bool isLineStart, bool isLineEnd)
+    //-----------------------------------------------------------
+{
+    // A line may arrive in pieces (isLineStart/isLineEnd) from the background writer
+    if (isLineStart)
+    {
+        if (linesOnPage >= LINESPERPAGE)
+        {
+            ListTopOfPageHeader();
+            linesOnPage = 0;
+        }
+        AppendInteger(sourceLineNumber, 4);
+        Append(" ", 1);
+    }
+    Append(sourceLine, sourceLineLength);
+    if (isLineEnd)
+    {
+        Append("\n", 1);
+        linesOnPage++;
+    }
+}
+
+//-----------------------------------------------------------
+void LISTER::FormatInformationLine(const char information[], int length, bool isLineStart, bool isLineEnd)
 //-----------------------------------------------------------
 {
-    if (linesOnPage >= LINESPERPAGE)
+    if (isLineStart && (linesOnPage >= LINESPERPAGE))
     {
         ListTopOfPageHeader();
         linesOnPage = 0;
     }
-    LIST << information << endl;
-    linesOnPage++;
+    Append(information, length);
+    if (isLineEnd)
+    {
+        Append("\n", 1);
+        linesOnPage++;
+    }
+}
+
+//-----------------------------------------------------------
+void LISTER::WriteBuffer()
+//-----------------------------------------------------------
+{
+    if (bufferLength > 0)
+    {
+        LIST.write(buffer, bufferLength);
+        bytesWritten += bufferLength;
+        bufferLength = 0;
+    }
+    LIST.flush();
 }
 
 //-----------------------------------------------------------
@@ -173,249 +530,1875 @@ void LISTER::ListTopOfPageHeader()
     ---- -------------------------------------------------------------------------------
     */
     const char FF = 0X0C;
+    const char LINE2[] = "Line Source Line";
+    const char LINE3[] = "---- -------------------------------------------------------------------------------";
+
+    // Page boundaries are the only places a partially-full buffer is written out
+    if (bufferLength >= BUFFERSIZE / 2) WriteBuffer();
+
+    pageNumber++;
+    Append(&FF, 1);
+    Append("\"", 1);
+    Append(sourceFileName, (int)strlen(sourceFileName));
+    Append("\" Page ", 7);
+    AppendInteger(pageNumber, 4);
+    Append("\n", 1);
+    Append(LINE2, (int)strlen(LINE2));
+    Append("\n", 1);
+    Append(LINE3, (int)strlen(LINE3));
+    Append("\n", 1);
+}
+
+//-----------------------------------------------------------
+void LISTER::Append(const char characters[], int length)
+//-----------------------------------------------------------
+{
+    if (bufferLength + length > BUFFERSIZE)
+    {
+        LIST.write(buffer, bufferLength);
+        bytesWritten += bufferLength;
+        bufferLength = 0;
+        if (length > BUFFERSIZE)
+        {
+            LIST.write(characters, length);
+            bytesWritten += length;
+            return;
+        }
+    }
+    memcpy(&buffer[bufferLength], characters, length);
+    bufferLength += length;
+}
+
+//-----------------------------------------------------------
+void LISTER::AppendInteger(int integer, int width)
+//-----------------------------------------------------------
+{
+    // Same as LIST << setw(width) << integer
+    char digits[11 + 1];
+    int n = 0;
+    unsigned int magnitude = (integer < 0) ? 0U - (unsigned int)integer : (unsigned int)integer;
+
+    do
+    {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (integer < 0) digits[sizeof(digits) - 1 - n++] = '-';
+    while (width > n)
+    {
+        Append(" ", 1);
+        width--;
+    }
+    Append(&digits[sizeof(digits) - n], n);
+}
+
+//-----------------------------------------------------------
+void LISTER::PushRecord(RECORDKIND kind, int number, const char text[], int length)
+//-----------------------------------------------------------
+{
+    // Lines longer than RECORDQUEUE::MAXIMUMPIECELENGTH are queued in pieces
+    do
+    {
+        int pieceLength = (length > RECORDQUEUE::MAXIMUMPIECELENGTH) ? RECORDQUEUE::MAXIMUMPIECELENGTH : length;
+
+        records->Push(kind, number, text, pieceLength, pieceLength == length);
+        text += pieceLength;
+        length -= pieceLength;
+        number = -1;          // -1 marks a continuation piece
+    } while (length > 0);
+}
+
+//-----------------------------------------------------------
+void LISTER::WriteRecords()
+//-----------------------------------------------------------
+{
+    /*
+       Background writer thread: the only code touching the page layout, buffer[],
+          and LIST while the background writer is running. When the queue is empty
+          it yields for a while and then sleeps briefly.
+    */
+    int sourceLineNumber = 0;
+    int idle = 0;
+
+    while (true)
+    {
+        RECORDQUEUE::RECORDHEADER header;
+        const char* text;
+
+        if (!records->Pop(header, text))
+        {
+            if (++idle < 64)
+                this_thread::yield();
+            else
+                this_thread::sleep_for(chrono::microseconds(100));
+            continue;
+        }
+        idle = 0;
+        switch (header.kind)
+        {
+        case SOURCELINE:
+            if (header.number != -1) sourceLineNumber = header.number;
+            FormatSourceLine(sourceLineNumber, text, header.length, header.number != -1, header.isLastPiece != 0);
+            break;
+        case INFORMATIONLINE:
+            FormatInformationLine(text, header.length, header.number != -1, header.isLastPiece != 0);
+            break;
+        case FLUSH:
+            WriteBuffer();
+            flushesCompleted.store(header.number, memory_order_release);
+            break;
+        case STOP:
+            records->Release();
+            return;
+        }
+        records->Release();
+    }
+}
+
+//-----------------------------------------------------------
+struct TRACEEVENT
+//-----------------------------------------------------------
+{
+    // Raw trace event; Format() turns it into a listing line only when the trace is dumped
+    void (*Format)(const TRACEEVENT& event, char information[]);
+    const void* context;                 // what Format() needs to interpret values[] (or NULL)
+    int values[4];
+    char text[TRACETEXTLENGTH + 1];      // copied (and truncated) text that will not outlive the event
+};
+
+//===========================================================
+class TRACER
+    //===========================================================
+{
+    /*
+       Runtime-selected trace categories. The trace points of a category that is
+          OFF cost one test of categories. Those of a category that is ON copy a
+          TRACEEVENT into a ring buffer holding the most recent events; nothing is
+          formatted until Dump() lists them.
+    */
+public:
+    enum CATEGORY
+    {
+        READERTRACE = 0x01,
+        SCANNERTRACE = 0x02,
+        PARSERTRACE = 0x04,
+        IDENTIFIERTABLETRACE = 0x08,
+        COMPILERTRACE = 0x10,
+        ALLTRACES = 0x1F
+    };
+
+private:
+    static const char CATEGORYNAMES[][15 + 1];
+
+private:
+    unsigned int categories;
+    size_t capacity;                     // a power of 2
+    vector<TRACEEVENT> events;           // ring; allocated when a category is first turned ON
+    long long loggedEvents;
+    long long dumpedEvents;
+
+public:
+    TRACER(int capacity = 65536);
+    void SetCategoriesON(unsigned int categories, const bool setting = true)
+    {
+        if (setting)
+        {
+            this->categories |= categories;
+            if (events.empty()) events.resize(capacity);
+        }
+        else
+            this->categories &= ~categories;
+    }
+    bool IsON(unsigned int categories) const
+    {
+        return((this->categories & categories) != 0);
+    }
+    //-----------------------------------------------------------
+    void Log(void (*Format)(const TRACEEVENT& event, char information[]), const void* context,
+        int value0 = 0, int value1 = 0, int value2 = 0, int value3 = 0, const char text[] = NULL)
+    //-----------------------------------------------------------
+    {
+        TRACEEVENT& event = events[(size_t)loggedEvents++ & (events.size() - 1)];
+
+        event.Format = Format;
+        event.context = context;
+        event.values[0] = value0;
+        event.values[1] = value1;
+        event.values[2] = value2;
+        event.values[3] = value3;
+        if (text == NULL)
+            event.text[0] = '\0';
+        else
+        {
+            strncpy(event.text, text, TRACETEXTLENGTH);
+            event.text[TRACETEXTLENGTH] = '\0';
+        }
+    }
+    void Dump(LISTER* lister);
+    static unsigned int ParseCategories(const char names[]);
+};
+
+//-----------------------------------------------------------
+const char TRACER::CATEGORYNAMES[][15 + 1] =
+//-----------------------------------------------------------
+{
+   "READER",
+   "SCANNER",
+   "PARSER",
+   "IDENTIFIERTABLE",
+   "COMPILER"
+};
+
+//-----------------------------------------------------------
+TRACER::TRACER(int capacity)
+//-----------------------------------------------------------
+{
+    this->capacity = 1;
+    while ((int)this->capacity < capacity) this->capacity *= 2;
+    categories = 0;
+    loggedEvents = 0;
+    dumpedEvents = 0;
+}
+
+//-----------------------------------------------------------
+void TRACER::Dump(LISTER* lister)
+//-----------------------------------------------------------
+{
+    // List (oldest first) the events logged since the last Dump() that are still in the ring
+    const long long first = max(dumpedEvents, loggedEvents - (long long)events.size());
+    char information[SOURCELINELENGTH + 1];
+
+    if (loggedEvents == dumpedEvents) return;
+    sprintf(information, "Trace: %lld events (%lld earlier events overwritten)",
+        loggedEvents - first, first - dumpedEvents);
+    lister->ListInformationLine(information);
+    for (long long i = first; i <= loggedEvents - 1; i++)
+    {
+        const TRACEEVENT& event = events[(size_t)i & (events.size() - 1)];
+
+        event.Format(event, information);
+        lister->ListInformationLine(information);
+    }
+    dumpedEvents = loggedEvents;
+}
+
+//-----------------------------------------------------------
+unsigned int TRACER::ParseCategories(const char names[])
+//-----------------------------------------------------------
+{
+    // names is a list like "SCANNER,IDENTIFIERTABLE" (any case, ',' or ' ' separated) or "ALL"
+    unsigned int categories = 0;
+    int i = 0;
+
+    while (names[i] != '\0')
+    {
+        char name[15 + 1];
+        int length = 0;
+
+        while ((names[i] == ',') || (names[i] == ' ')) i++;
+        while ((names[i] != '\0') && (names[i] != ',') && (names[i] != ' '))
+        {
+            if (length <= 15 - 1) name[length++] = toupper(names[i]);
+            i++;
+        }
+        name[length] = '\0';
+        if (strcmp(name, "ALL") == 0)
+            categories |= ALLTRACES;
+        for (int k = 0; k <= (int)(sizeof(CATEGORYNAMES) / sizeof(CATEGORYNAMES[0])) - 1; k++)
+            if (strcmp(name, CATEGORYNAMES[k]) == 0)
+                categories |= (1U << k);
+    }
+    return(categories);
+}
+
+//===========================================================
+class STATISTICS
+    //===========================================================
+{
+    /*
+       Runtime-selected compile-time report. Each phase is charged its *exclusive*
+          time, measured with a monotonic clock: time spent in a nested phase (for
+          example, READER I/O while GetNextToken() is scanning) is charged only to
+          the nested phase, and time outside every phase is charged to OTHERPHASE.
+          While the statistics are OFF, the phase and counter points cost one test.
+    */
+public:
+    enum PHASE
+    {
+        OTHERPHASE,
+        READERPHASE,
+        SCANNERPHASE,
+        PARSERPHASE,
+        IDENTIFIERTABLEPHASE,
+        CODEPHASE,
+        PHASES
+    };
+    enum COUNTER
+    {
+        CHARACTERS,                // source characters read (each end-of-line counts as one)
+        SOURCELINES,
+        TOKENS,
+        LOOKUPS,                   // IDENTIFIERTABLE::GetIndex() calls
+        LOOKUPHITS,
+        LOOKUPHITSDEPTH0,          // hits declared in the current scope, ...
+        LOOKUPHITSDEPTH1,
+        LOOKUPHITSDEPTH2,
+        LOOKUPHITSDEPTH3,          // ... and hits declared 3 or more scopes out
+        IDENTIFIERSADDED,
+        INSTRUCTIONS,              // CODE::EmitFormattedLine() lines (instructions and directives)
+        UNFORMATTEDLINES,          // CODE::EmitUnformattedLine() lines (comments)
+        STATICDATARECORDS,
+        POOLEDLITERALS,            // CODE::AddDSToStaticData() literals found in the literal pool
+        LITERALPOOLBYTESSAVED,     // ... and the static data they would have taken
+        PEEPHOLEHITS,              // CODE peephole rules applied
+        PEEPHOLEREMOVED,           // ... and the instructions they removed
+        COUNTERS
+    };
+
+    //-----------------------------------------------------------
+    class TIMER
+    //-----------------------------------------------------------
+    {
+        // Charges the rest of the enclosing block (even when it throws) to phase
+    private:
+        STATISTICS* statistics;
+
+    public:
+        TIMER(STATISTICS* statistics, PHASE phase)
+        {
+            this->statistics = ((statistics != NULL) && statistics->IsON()) ? statistics : NULL;
+            if (this->statistics != NULL) this->statistics->EnterPhase(phase);
+        }
+        ~TIMER()
+        {
+            if (statistics != NULL) statistics->ExitPhase();
+        }
+    };
+
+private:
+    static const char PHASENAMES[][15 + 1];
+    static const char COUNTERNAMES[][22 + 1];
+
+    struct OUTPUTFILE
+    {
+        char fileName[80 + 1];
+        long long bytes;
+    };
+
+private:
+    bool isON;
+    chrono::steady_clock::time_point last;   // when the phase on top of phases[] was last charged
+    vector<int> phases;                      // [0] is always OTHERPHASE
+    long long nanoseconds[PHASES];
+    long long counters[COUNTERS];
+    vector<OUTPUTFILE> outputFiles;
+
+public:
+    STATISTICS();
+    void SetON(const bool setting = true)
+    {
+        // The clock starts when the statistics are turned ON
+        if (setting && !isON) last = chrono::steady_clock::now();
+        this->isON = setting;
+    }
+    bool IsON() const
+    {
+        return(this->isON);
+    }
+    void EnterPhase(PHASE phase)
+    {
+        Charge();
+        phases.push_back(phase);
+    }
+    void ExitPhase()
+    {
+        Charge();
+        if (phases.size() > 1) phases.pop_back();
+    }
+    void Count(COUNTER counter, long long count = 1)
+    {
+        counters[counter] += count;
+    }
+    long long GetCount(COUNTER counter) const
+    {
+        return(counters[counter]);
+    }
+    double GetSeconds(PHASE phase)
+    {
+        if (isON) Charge();
+        return(nanoseconds[phase] / 1.0e9);
+    }
+    static const char* GetPhaseName(PHASE phase)
+    {
+        return(PHASENAMES[phase]);
+    }
+    void AddOutputFile(const char fileName[], long long bytes);
+    void Report(ostream& OUT, bool asJSON);
+    static bool IsJSONFormat(const char format[]);
+private:
+    void Charge()
+    {
+        const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+        nanoseconds[phases.back()] += chrono::duration_cast<chrono::nanoseconds>(now - last).count();
+        last = now;
+    }
+};
+
+//-----------------------------------------------------------
+const char STATISTICS::PHASENAMES[][15 + 1] =
+//-----------------------------------------------------------
+{
+   "other",
+   "reader",
+   "scanner",
+   "parser",
+   "identifierTable",
+   "code"
+};
+
+//-----------------------------------------------------------
+const char STATISTICS::COUNTERNAMES[][22 + 1] =
+//-----------------------------------------------------------
+{
+   "characters",
+   "sourceLines",
+   "tokens",
+   "lookups",
+   "lookupHits",
+   "lookupHitsDepth0",
+   "lookupHitsDepth1",
+   "lookupHitsDepth2",
+   "lookupHitsDepth3OrMore",
+   "identifiersAdded",
+   "instructions",
+   "unformattedLines",
+   "staticDataRecords",
+   "pooledLiterals",
+   "literalPoolBytesSaved",
+   "peepholeHits",
+   "peepholeRemoved"
+};
+
+//-----------------------------------------------------------
+STATISTICS::STATISTICS()
+//-----------------------------------------------------------
+{
+    isON = false;
+    phases.reserve(16);
+    phases.push_back(OTHERPHASE);
+    for (int i = 0; i <= PHASES - 1; i++)
+        nanoseconds[i] = 0;
+    for (int i = 0; i <= COUNTERS - 1; i++)
+        counters[i] = 0;
+}
+
+//-----------------------------------------------------------
+void STATISTICS::AddOutputFile(const char fileName[], long long bytes)
+//-----------------------------------------------------------
+{
+    OUTPUTFILE outputFile;
+
+    strncpy(outputFile.fileName, fileName, 80);
+    outputFile.fileName[80] = '\0';
+    outputFile.bytes = bytes;
+    outputFiles.push_back(outputFile);
+}
+
+//-----------------------------------------------------------
+bool STATISTICS::IsJSONFormat(const char format[])
+//-----------------------------------------------------------
+{
+    // format is "JSON" (any case) or anything else (for example, "TEXT") for the text report
+    const char JSON[] = "JSON";
+    int i = 0;
+
+    while ((JSON[i] != '\0') && (toupper(format[i]) == JSON[i])) i++;
+    return((JSON[i] == '\0') && (format[i] == '\0'));
+}
+
+//-----------------------------------------------------------
+void STATISTICS::Report(ostream& OUT, bool asJSON)
+//-----------------------------------------------------------
+{
+    /*
+       The text report is for people; the JSON report is one object
+          {"seconds":{...},"counters":{...},"bytesWritten":{...}}
+          on one line, for tools that track compile performance across releases.
+    */
+    char line[SOURCELINELENGTH + 1];
+    long long total = 0;
+
+    if (isON) Charge();
+    for (int i = 0; i <= PHASES - 1; i++)
+        total += nanoseconds[i];
+
+    if (asJSON)
+    {
+        OUT << "{\"seconds\":{";
+        for (int i = 0; i <= PHASES - 1; i++)
+        {
+            sprintf(line, "\"%s\":%.9f,", PHASENAMES[i], nanoseconds[i] / 1e9);
+            OUT << line;
+        }
+        sprintf(line, "\"total\":%.9f},\"counters\":{", total / 1e9);
+        OUT << line;
+        for (int i = 0; i <= COUNTERS - 1; i++)
+        {
+            sprintf(line, "%s\"%s\":%lld", ((i == 0) ? "" : ","), COUNTERNAMES[i], counters[i]);
+            OUT << line;
+        }
+        OUT << "},\"bytesWritten\":{";
+        for (int i = 0; i <= (int)outputFiles.size() - 1; i++)
+        {
+            // File names are the only strings that need JSON escaping
+            OUT << ((i == 0) ? "\"" : ",\"");
+            for (int k = 0; outputFiles[i].fileName[k] != '\0'; k++)
+            {
+                const char c = outputFiles[i].fileName[k];
+
+                if ((c == '"') || (c == '\\'))
+                    OUT << '\\' << c;
+                else if ((unsigned char)c < ' ')
+                {
+                    sprintf(line, "\\u%04x", (unsigned char)c);
+                    OUT << line;
+                }
+                else
+                    OUT << c;
+            }
+            sprintf(line, "\":%lld", outputFiles[i].bytes);
+            OUT << line;
+        }
+        OUT << "}}" << endl;
+    }
+    else
+    {
+        OUT << "AGL compile-time report" << endl;
+        OUT << "   Phase                       Seconds  Percent" << endl;
+        for (int i = 0; i <= PHASES - 1; i++)
+        {
+            sprintf(line, "   %-22s %12.6f %7.1f%%", PHASENAMES[i], nanoseconds[i] / 1e9,
+                (total == 0) ? 0.0 : 100.0 * nanoseconds[i] / total);
+            OUT << line << endl;
+        }
+        sprintf(line, "   %-22s %12.6f", "total", total / 1e9);
+        OUT << line << endl;
+        OUT << "   Counter                         Count" << endl;
+        for (int i = 0; i <= COUNTERS - 1; i++)
+        {
+            sprintf(line, "   %-22s %14lld", COUNTERNAMES[i], counters[i]);
+            OUT << line << endl;
+        }
+        OUT << "   Output file                     Bytes" << endl;
+        for (int i = 0; i <= (int)outputFiles.size() - 1; i++)
+        {
+            sprintf(line, "   %-22s %14lld", outputFiles[i].fileName, outputFiles[i].bytes);
+            OUT << line << endl;
+        }
+    }
+}
+
+//===========================================================
+class MAPPEDFILE
+    //===========================================================
+{
+    /*
+       Read-only memory mapping of an entire file. The READER memory-mapped backend
+          scans source lines directly out of the mapping (zero-copy) instead of
+          copying each line through ifstream::getline().
+    */
+private:
+    bool isOpen;
+    const char* base;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+public:
+    MAPPEDFILE();
+    ~MAPPEDFILE();
+    bool Open(const char fullFileName[]);
+    void Close();
+    bool IsOpen()
+    {
+        return(isOpen);
+    }
+    const char* GetBase()
+    {
+        return(base);
+    }
+    size_t GetSize()
+    {
+        return(size);
+    }
+};
+
+//-----------------------------------------------------------
+MAPPEDFILE::MAPPEDFILE()
+//-----------------------------------------------------------
+{
+    base = NULL;
+    size = 0;
+    isOpen = false;
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+}
+
+//-----------------------------------------------------------
+MAPPEDFILE::~MAPPEDFILE()
+//-----------------------------------------------------------
+{
+    Close();
+}
+
+//-----------------------------------------------------------
+bool MAPPEDFILE::Open(const char fullFileName[])
+//-----------------------------------------------------------
+{
+    /*
+       An empty file cannot be mapped, so it is "opened" with base = NULL and size = 0
+    */
+#ifdef _WIN32
+    LARGE_INTEGER fileSize;
+
+    file = CreateFileA(fullFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return(false);
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        Close();
+        return(false);
+    }
+    size = (size_t)fileSize.QuadPart;
+    if (size > 0)
+    {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+        {
+            Close();
+            return(false);
+        }
+        base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (base == NULL)
+        {
+            Close();
+            return(false);
+        }
+    }
+#else
+    struct stat fileStatus;
+    int file;
+
+    file = open(fullFileName, O_RDONLY);
+    if (file < 0) return(false);
+    if (fstat(file, &fileStatus) != 0)
+    {
+        close(file);
+        return(false);
+    }
+    size = (size_t)fileStatus.st_size;
+    if (size > 0)
+    {
+        void* address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        if (address == MAP_FAILED)
+        {
+            close(file);
+            size = 0;
+            return(false);
+        }
+        base = (const char*)address;
+        madvise(address, size, MADV_SEQUENTIAL);
+    }
+    // The mapping remains valid after its file descriptor is closed
+    close(file);
+#endif
+    isOpen = true;
+    return(true);
+}
+
+//-----------------------------------------------------------
+void MAPPEDFILE::Close()
+//-----------------------------------------------------------
+{
+#ifdef _WIN32
+    if (base != NULL) UnmapViewOfFile(base);
+    if (mapping != NULL) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (base != NULL) munmap((void*)base, size);
+#endif
+    base = NULL;
+    size = 0;
+    isOpen = false;
+}
+
+//===========================================================
+template <typename ELEMENT, int LOOKAHEAD>
+class LOOKAHEADWINDOW
+    //===========================================================
+{
+    /*
+       Fixed-capacity ring buffer holding a look-ahead "window" of LOOKAHEAD+1
+          elements, where [0] is the current element and [LOOKAHEAD] the furthest
+          look-ahead. Advance() slides the window by moving the ring head (one index
+          increment) instead of copying every element down one position. The ring
+          capacity is rounded up to a power of 2 so wrap-around is a mask.
+    */
+private:
+    static constexpr int RoundUpToPowerOf2(int n)
+    {
+        return((n <= 1) ? 1 : 2 * RoundUpToPowerOf2((n + 1) / 2));
+    }
+    static const int CAPACITY = RoundUpToPowerOf2(LOOKAHEAD + 1);
+
+    ELEMENT elements[CAPACITY];
+    int head;
+
+public:
+    LOOKAHEADWINDOW()
+    {
+        head = 0;
+    }
+    ELEMENT& operator[](int index)
+    {
+        return(elements[(head + index) & (CAPACITY - 1)]);
+    }
+    const ELEMENT& operator[](int index) const
+    {
+        return(elements[(head + index) & (CAPACITY - 1)]);
+    }
+    /*
+       Discard [0], shift the window, and return the (stale) new [LOOKAHEAD] element
+          for the caller to overwrite
+    */
+    ELEMENT& Advance()
+    {
+        head = (head + 1) & (CAPACITY - 1);
+        return(elements[(head + LOOKAHEAD) & (CAPACITY - 1)]);
+    }
+};
+
+//===========================================================
+struct NEXTCHARACTER
+    //===========================================================
+{
+    char character;
+    int sourceLineNumber;
+    int sourceLineIndex;
+};
+
+//===========================================================
+struct SOURCELINEBATCH
+    //===========================================================
+{
+    /*
+       A batch of consecutive source lines handed to asynchronous callback functions.
+          Source line i is characters[ sourceLineEnds[i-1],sourceLineEnds[i] ) and is
+          *NOT* '\0'-terminated.
+    */
+    vector<int> sourceLineNumbers;
+    vector<int> sourceLineEnds;
+    vector<char> characters;
+
+    int GetCountOfSourceLines() const
+    {
+        return((int)sourceLineNumbers.size());
+    }
+    int GetSourceLineNumber(int i) const
+    {
+        return(sourceLineNumbers[i]);
+    }
+    const char* GetSourceLine(int i, int& sourceLineLength) const
+    {
+        int begin = (i == 0) ? 0 : sourceLineEnds[i - 1];
+
+        sourceLineLength = sourceLineEnds[i] - begin;
+        return(characters.data() + begin);
+    }
+    void Clear()
+    {
+        // clear() keeps the vectors' capacity so batch storage is re-used
+        sourceLineNumbers.clear();
+        sourceLineEnds.clear();
+        characters.clear();
+    }
+};
+
+//===========================================================
+class SOURCELINEQUEUE
+    //===========================================================
+{
+    /*
+       Bounded single-producer/single-consumer queue of SOURCELINEBATCHes. READER (the
+          producer) copies each source line into the batch being filled; full batches
+          are drained by a background thread that gives each batch to every
+          asynchronous callback function, so slow consumers (console echo) no longer
+          stall the scanner. The queue is a fixed ring of BATCHES batches; when every
+          batch is full the producer waits, which bounds memory use. The producer may
+          add callback functions while the background thread runs (they see the
+          batches consumed from then on): CallbackFunctions is only changed under
+          queueMutex, and the background thread calls its own copy of it.
+    */
+public:
+    static const int BATCHES = 4;
+    static const int LINESPERBATCH = 256;
+
+private:
+    SOURCELINEBATCH batches[BATCHES];
+    int head;                  // next full batch to consume
+    int count;                 // number of full batches
+    int fillIndex;             // batch being filled by the producer
+    bool isStopping;
+    vector<void (*)(const SOURCELINEBATCH& batch)> CallbackFunctions;
+    atomic<int> numberCallbacks;   // CallbackFunctions.size(), read by the producer without the lock
+    thread consumer;
+    mutex queueMutex;
+    condition_variable queueChanged;
+
+public:
+    SOURCELINEQUEUE();
+    ~SOURCELINEQUEUE();
+    void AddCallbackFunction(void (*CallbackFunction)(const SOURCELINEBATCH& batch));
+    int GetCountOfCallbackFunctions()
+    {
+        return(numberCallbacks.load(memory_order_relaxed));
+    }
+    void AddSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength);
+    void Flush(bool waitUntilDrained);
+    void Stop();
+
+private:
+    void Publish();
+    void DrainBatches();
+};
+
+//-----------------------------------------------------------
+SOURCELINEQUEUE::SOURCELINEQUEUE()
+//-----------------------------------------------------------
+{
+    head = 0;
+    count = 0;
+    fillIndex = 0;
+    isStopping = false;
+    numberCallbacks = 0;
+}
+
+//-----------------------------------------------------------
+SOURCELINEQUEUE::~SOURCELINEQUEUE()
+//-----------------------------------------------------------
+{
+    Stop();
+}
+
+//-----------------------------------------------------------
+void SOURCELINEQUEUE::AddCallbackFunction(void (*CallbackFunction)(const SOURCELINEBATCH& batch))
+//-----------------------------------------------------------
+{
+    // The background thread is started with the first asynchronous callback function
+    {
+        lock_guard<mutex> lock(queueMutex);
+
+        CallbackFunctions.push_back(CallbackFunction);
+        numberCallbacks.store((int)CallbackFunctions.size(), memory_order_relaxed);
+    }
+    if (!consumer.joinable())
+        consumer = thread(&SOURCELINEQUEUE::DrainBatches, this);
+}
+
+//-----------------------------------------------------------
+void SOURCELINEQUEUE::AddSourceLine(int sourceLineNumber, const char sourceLine[], int sourceLineLength)
+//-----------------------------------------------------------
+{
+    SOURCELINEBATCH& batch = batches[fillIndex];
+
+    batch.sourceLineNumbers.push_back(sourceLineNumber);
+    batch.characters.insert(batch.characters.end(), sourceLine, sourceLine + sourceLineLength);
+    batch.sourceLineEnds.push_back((int)batch.characters.size());
+    if (batch.GetCountOfSourceLines() >= LINESPERBATCH)
+        Publish();
+}
+
+//-----------------------------------------------------------
+void SOURCELINEQUEUE::Publish()
+//-----------------------------------------------------------
+{
+    /*
+       Hand the batch being filled to the consumer, then wait (if necessary) until
+          the next batch in the ring has been consumed so it can be re-filled
+    */
+    unique_lock<mutex> lock(queueMutex);
+
+    count++;
+    fillIndex = (fillIndex + 1) % BATCHES;
+    queueChanged.notify_all();
+    queueChanged.wait(lock, [this] { return(count < BATCHES); });
+    batches[fillIndex].Clear();
+}
+
+//-----------------------------------------------------------
+void SOURCELINEQUEUE::Flush(bool waitUntilDrained)
+//-----------------------------------------------------------
+{
+    if (!consumer.joinable()) return;
+    if (batches[fillIndex].GetCountOfSourceLines() > 0)
+        Publish();
+    if (waitUntilDrained)
+    {
+        unique_lock<mutex> lock(queueMutex);
+
+        queueChanged.wait(lock, [this] { return(count == 0); });
+    }
+}
+
+//-----------------------------------------------------------
+void SOURCELINEQUEUE::Stop()
+//-----------------------------------------------------------
+{
+    if (!consumer.joinable()) return;
+    Flush(false);
+    {
+        lock_guard<mutex> lock(queueMutex);
+
+        isStopping = true;
+    }
+    queueChanged.notify_all();
+    consumer.join();
+}
+
+//-----------------------------------------------------------
+void SOURCELINEQUEUE::DrainBatches()
+//-----------------------------------------------------------
+{
+    // Background thread: the full batch at head is only touched by this thread until count--
+    vector<void (*)(const SOURCELINEBATCH& batch)> callbacks;
+
+    while (true)
+    {
+        unique_lock<mutex> lock(queueMutex);
+
+        queueChanged.wait(lock, [this] { return((count > 0) || isStopping); });
+        if (count == 0) break;
+        // Copied while locked, so a callback function added meanwhile cannot reallocate it
+        callbacks = CallbackFunctions;
+        lock.unlock();
+
+        for (size_t i = 0; i < callbacks.size(); i++)
+            (*callbacks[i])(batches[head]);
+
+        lock.lock();
+        head = (head + 1) % BATCHES;
+        count--;
+        queueChanged.notify_all();
+    }
+}
+
+//===========================================================
+class CHARACTERRUNS
+    //===========================================================
+{
+    /*
+       Kernels that return the length of the run of characters at the beginning of
+          span[0..n-1] for the scanner's bulk skipping. With SIMDSCANNER they test
+          32 (AVX2) or 16 (SSE2) characters per step, the last step overlapping the
+          previous one so no scalar tail is needed (only spans shorter than one step
+          use the scalar kernel). Characters >= 0X80 are never letters or digits
+          (bytes compare as signed). FindCharacter() (index of the first c, n when
+          there is none) is memchr(), which the C libraries already vectorize.
+    */
+public:
+    static int SpaceRunLength(const char span[], int n);
+    static int IdentifierRunLength(const char span[], int n);
+    static int DigitRunLength(const char span[], int n);
+    static int FindCharacter(const char span[], int n, char c)
+    {
+        const char* found = (const char*)memchr(span, c, n);
+
+        return((found != NULL) ? (int)(found - span) : n);
+    }
+
+    static int ScalarSpaceRunLength(const char span[], int n)
+    {
+        int j = 0;
+
+        while ((j < n) && ((span[j] == ' ') || (span[j] == '\t'))) j++;
+        return(j);
+    }
+    static int ScalarIdentifierRunLength(const char span[], int n)
+    {
+        int j = 0;
+
+        while ((j < n) && IsIdentifierCharacter(span[j])) j++;
+        return(j);
+    }
+    static int ScalarDigitRunLength(const char span[], int n)
+    {
+        int j = 0;
+
+        while ((j < n) && ('0' <= span[j]) && (span[j] <= '9')) j++;
+        return(j);
+    }
+
+private:
+    static bool IsIdentifierCharacter(char c)
+    {
+        return((('a' <= (c | 0X20)) && ((c | 0X20) <= 'z')) || (('0' <= c) && (c <= '9')) || (c == '_'));
+    }
+#if defined(SIMDAVX2) || defined(SIMDSSE2)
+    static int FirstSetBit(unsigned int mask)
+    {
+        // mask != 0
+#ifdef _MSC_VER
+        unsigned long index;
+
+        _BitScanForward(&index, mask);
+        return((int)index);
+#else
+        return(__builtin_ctz(mask));
+#endif
+    }
+#endif
+#if defined(SIMDAVX2)
+    static const int STRIDE = 32;
+    typedef __m256i VECTOR;
+    static VECTOR Load(const char* p) { return(_mm256_loadu_si256((const __m256i*)p)); }
+    static VECTOR Splat(char c) { return(_mm256_set1_epi8(c)); }
+    static VECTOR Equal(VECTOR a, VECTOR b) { return(_mm256_cmpeq_epi8(a, b)); }
+    static VECTOR Greater(VECTOR a, VECTOR b) { return(_mm256_cmpgt_epi8(a, b)); }
+    static VECTOR Or(VECTOR a, VECTOR b) { return(_mm256_or_si256(a, b)); }
+    static VECTOR And(VECTOR a, VECTOR b) { return(_mm256_and_si256(a, b)); }
+    static unsigned int Mask(VECTOR a) { return((unsigned int)_mm256_movemask_epi8(a)); }
+    static const unsigned int ALLSET = 0XFFFFFFFFU;
+#elif defined(SIMDSSE2)
+    static const int STRIDE = 16;
+    typedef __m128i VECTOR;
+    static VECTOR Load(const char* p) { return(_mm_loadu_si128((const __m128i*)p)); }
+    static VECTOR Splat(char c) { return(_mm_set1_epi8(c)); }
+    static VECTOR Equal(VECTOR a, VECTOR b) { return(_mm_cmpeq_epi8(a, b)); }
+    static VECTOR Greater(VECTOR a, VECTOR b) { return(_mm_cmpgt_epi8(a, b)); }
+    static VECTOR Or(VECTOR a, VECTOR b) { return(_mm_or_si128(a, b)); }
+    static VECTOR And(VECTOR a, VECTOR b) { return(_mm_and_si128(a, b)); }
+    static unsigned int Mask(VECTOR a) { return((unsigned int)_mm_movemask_epi8(a)); }
+    static const unsigned int ALLSET = 0XFFFFU;
+#endif
+};
+
+//-----------------------------------------------------------
+inline int CHARACTERRUNS::SpaceRunLength(const char span[], int n)
+//-----------------------------------------------------------
+{
+#if defined(SIMDAVX2) || defined(SIMDSSE2)
+    int j = 0;
+    const VECTOR SPACES = Splat(' ');
+    const VECTOR TABS = Splat('\t');
+
+    if (n >= STRIDE)
+    {
+        while (true)
+        {
+            VECTOR characters = Load(&span[j]);
+            unsigned int mask = Mask(Or(Equal(characters, SPACES), Equal(characters, TABS)));
+
+            if (mask != ALLSET) return(j + FirstSetBit(~mask));
+            if (j == n - STRIDE) return(n);
+            j = (j + 2 * STRIDE <= n) ? j + STRIDE : n - STRIDE;
+        }
+    }
+#endif
+    return(ScalarSpaceRunLength(span, n));
+}
+
+//-----------------------------------------------------------
+inline int CHARACTERRUNS::IdentifierRunLength(const char span[], int n)
+//-----------------------------------------------------------
+{
+#if defined(SIMDAVX2) || defined(SIMDSSE2)
+    int j = 0;
+    const VECTOR CASEBIT = Splat(0X20);
+    const VECTOR BEFOREa = Splat('a' - 1);
+    const VECTOR AFTERz = Splat('z' + 1);
+    const VECTOR BEFORE0 = Splat('0' - 1);
+    const VECTOR AFTER9 = Splat('9' + 1);
+    const VECTOR UNDERSCORES = Splat('_');
+
+    if (n >= STRIDE)
+    {
+        while (true)
+        {
+            VECTOR characters = Load(&span[j]);
+            VECTOR folded = Or(characters, CASEBIT);
+            VECTOR letters = And(Greater(folded, BEFOREa), Greater(AFTERz, folded));
+            VECTOR digits = And(Greater(characters, BEFORE0), Greater(AFTER9, characters));
+            unsigned int mask = Mask(Or(Or(letters, digits), Equal(characters, UNDERSCORES)));
+
+            if (mask != ALLSET) return(j + FirstSetBit(~mask));
+            if (j == n - STRIDE) return(n);
+            j = (j + 2 * STRIDE <= n) ? j + STRIDE : n - STRIDE;
+        }
+    }
+#endif
+    return(ScalarIdentifierRunLength(span, n));
+}
+
+//-----------------------------------------------------------
+inline int CHARACTERRUNS::DigitRunLength(const char span[], int n)
+//-----------------------------------------------------------
+{
+#if defined(SIMDAVX2) || defined(SIMDSSE2)
+    int j = 0;
+    const VECTOR BEFORE0 = Splat('0' - 1);
+    const VECTOR AFTER9 = Splat('9' + 1);
+
+    if (n >= STRIDE)
+    {
+        while (true)
+        {
+            VECTOR characters = Load(&span[j]);
+            unsigned int mask = Mask(And(Greater(characters, BEFORE0), Greater(AFTER9, characters)));
+
+            if (mask != ALLSET) return(j + FirstSetBit(~mask));
+            if (j == n - STRIDE) return(n);
+            j = (j + 2 * STRIDE <= n) ? j + STRIDE : n - STRIDE;
+        }
+    }
+#endif
+    return(ScalarDigitRunLength(span, n));
+}
+
+//===========================================================
+template <int CALLBACKSALLOWED = 5, int LOOKAHEAD = 0>
+class READER
+    //===========================================================
+{
+public:
+    static const char EOPC = 0;
+    static const char EOLC = '\n';
+    static const char TABC = '\t';
+
+private:
+    const int SOURCELINELENGTH;
+
+    char* lineBuffer;
+    int lineBufferCapacity;
+    const char* sourceLine;
+    int sourceLineLength;
+    int sourceLineNumber;
+    int sourceLineIndex;
+    long long sourceLineOffset;
+    LOOKAHEADWINDOW<NEXTCHARACTER, LOOKAHEAD> nextCharacters;
+    ifstream SOURCE;
+    LISTER* lister;
+    TRACER* tracer;
+    STATISTICS* statistics;
+    bool atEOP;
+    int numberCallbacks;
+    void (*CallbackFunctions[CALLBACKSALLOWED + 1])
+        (int sourceLineNumber, const char sourceLine[], int sourceLineLength);
+    SOURCELINEQUEUE asynchronousCallbacks;
+    //--------------------------------------------------
+    // memory-mapped source backend
+    //--------------------------------------------------
+    bool mappedSourceON;
+    MAPPEDFILE MAPPEDSOURCE;
+    const char* mappedSourceBase;
+    size_t mappedSourceSize;
+    size_t mappedSourceIndex;
+    long long sourceSize;
+
+public:
+    READER(const int SOURCELINELENGTH = 512);
+    ~READER();
+    void OpenFile(const char sourceFileName[]);
+    void OpenMemory(const char characters[], size_t size);
+    void ReadRemainingSourceLines();
+    void SetLister(LISTER* lister);
+    void SetTracer(TRACER* tracer)
+    {
+        this->tracer = tracer;
+    }
+    void SetStatistics(STATISTICS* statistics)
+    {
+        this->statistics = statistics;
+    }
+    NEXTCHARACTER GetNextCharacter();
+    NEXTCHARACTER GetLookAheadCharacter(int index);
+    int GetCharacterSpan(const char*& span);
+    NEXTCHARACTER SkipCharacters(int count);
+    void AddCallbackFunction(void (*CallbackFunction)
+        (int sourceLineNumber, const char sourceLine[], int sourceLineLength));
+    void AddAsynchronousCallbackFunction(void (*CallbackFunction)
+        (const SOURCELINEBATCH& batch));
+    void FlushAsynchronousCallbacks();
+    void SetMappedSourceON(const bool setting = true)
+    {
+        this->mappedSourceON = setting;
+    }
+    bool GetMappedSourceON()
+    {
+        return(this->mappedSourceON);
+    }
+    long long GetSourceSize()
+    {
+        // Size (bytes) of the source file opened by OpenFile()
+        return(this->sourceSize);
+    }
+private:
+    static void FormatCharacterEvent(const TRACEEVENT& event, char information[]);
+    void FillLookAheadWindow();
+    void ReadSourceLine();
+    void ReadStreamSourceLine();
+    void ReadMappedSourceLine();
+};
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+READER<CALLBACKSALLOWED, LOOKAHEAD>::READER(const int SOURCELINELENGTH) :
+    SOURCELINELENGTH(SOURCELINELENGTH)
+    //-----------------------------------------------------------
+{
+    /*
+       SOURCELINELENGTH is only the *initial* capacity of lineBuffer[]; the buffer
+          doubles whenever a longer source line is read, so it is bounded by the
+          longest source line and no allocation occurs in the steady state.
+    */
+    lineBufferCapacity = SOURCELINELENGTH + 2;
+    lineBuffer = new char[lineBufferCapacity];
+    sourceLine = lineBuffer;
+    sourceLineLength = 0;
+    sourceLineNumber = 0;
+    sourceLineOffset = 0;
+    atEOP = false;
+    lister = NULL;
+    tracer = NULL;
+    statistics = NULL;
+    numberCallbacks = 0;
+    mappedSourceON = false;
+    mappedSourceBase = NULL;
+    mappedSourceSize = 0;
+    mappedSourceIndex = 0;
+    sourceSize = 0;
+    //   cout << "Maximum-length-source-line = " << SOURCELINELENGTH+2 << endl;
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+READER<CALLBACKSALLOWED, LOOKAHEAD>::~READER()
+//-----------------------------------------------------------
+{
+    asynchronousCallbacks.Stop();
+    delete[] lineBuffer;
+    if (SOURCE.is_open()) SOURCE.close();
+    if (MAPPEDSOURCE.IsOpen()) MAPPEDSOURCE.Close();
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::OpenFile(const char sourceFileName[])
+//-----------------------------------------------------------
+{
+    char fullFileName[80 + 1];
+
+    strcpy(fullFileName, sourceFileName);
+    strcat(fullFileName, ".agl");
+    if (mappedSourceON)
+    {
+        if (!MAPPEDSOURCE.Open(fullFileName)) throw(AGLEXCEPTION("Unable to open source file"));
+        mappedSourceBase = MAPPEDSOURCE.GetBase();
+        mappedSourceSize = MAPPEDSOURCE.GetSize();
+        mappedSourceIndex = 0;
+        sourceSize = (long long)mappedSourceSize;
+    }
+    else
+    {
+        SOURCE.open(fullFileName, ios::in);
+        if (!SOURCE.is_open()) throw(AGLEXCEPTION("Unable to open source file"));
+        SOURCE.seekg(0, ios::end);
+        sourceSize = (long long)SOURCE.tellg();
+        SOURCE.seekg(0, ios::beg);
+    }
+
+    FillLookAheadWindow();
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::OpenMemory(const char characters[], size_t size)
+//-----------------------------------------------------------
+{
+    /*
+       Read source lines from characters[0..size-1] (which the caller keeps valid)
+          with the memory-mapped backend; source line numbers start at 1. Used to
+          scan a part of a source file (see ScanSourceInParallel()). The lister may
+          be NULL, in which case source lines are not listed.
+    */
+    mappedSourceON = true;
+    mappedSourceBase = characters;
+    mappedSourceSize = size;
+    mappedSourceIndex = 0;
+    sourceSize = (long long)size;
+    FillLookAheadWindow();
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::FillLookAheadWindow()
+//-----------------------------------------------------------
+{
+    // Read first source line and "fill" nextCharacters[] (a re-opened READER starts over at line 1)
+    sourceLineNumber = 0;
+    atEOP = false;
+    ReadSourceLine();
+    for (int i = 0; i <= LOOKAHEAD; i++)
+    {
+        nextCharacters[i].character = READER::EOPC;
+        nextCharacters[i].sourceLineNumber = 0;
+        nextCharacters[i].sourceLineIndex = 0;
+    }
+    for (int i = 0; i <= LOOKAHEAD; i++)
+        GetNextCharacter();
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::ReadRemainingSourceLines()
+//-----------------------------------------------------------
+{
+    /*
+       List (and give to the callback functions) every source line not read yet, as
+          if the scanner had consumed them; the look-ahead "window" is not refilled
+    */
+    while (!atEOP)
+        ReadSourceLine();
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::SetLister(LISTER* lister)
+//-----------------------------------------------------------
+{
+    this->lister = lister;
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::FormatCharacterEvent(const TRACEEVENT& event, char information[])
+//-----------------------------------------------------------
+{
+    // values[] = { sourceLineNumber, sourceLineIndex, character }
+    const char character = (char)event.values[2];
+
+    if (isprint(character))
+        sprintf(information, "At (%4d:%3d) %02X = %c",
+            event.values[0], event.values[1], character, character);
+    else if (character == READER::EOPC)
+        sprintf(information, "At (%4d:%3d) %02X = EOPC",
+            event.values[0], event.values[1], character);
+    else if (character == READER::EOLC)
+        sprintf(information, "At (%4d:%3d) %02X = EOLC",
+            event.values[0], event.values[1], character);
+    else if (character == READER::TABC)
+        sprintf(information, "At (%4d:%3d) %02X = TABC",
+            event.values[0], event.values[1], character);
+    else
+        sprintf(information, "At (%4d:%3d) %02X = ???",
+            event.values[0], event.values[1], character);
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+NEXTCHARACTER READER<CALLBACKSALLOWED, LOOKAHEAD>::GetNextCharacter()
+//-----------------------------------------------------------
+{
+    char character;
+
+    // Move look-ahead "window" to make room for next character
+    NEXTCHARACTER& lookAheadCharacter = nextCharacters.Advance();
+
+    lookAheadCharacter.sourceLineNumber = sourceLineNumber;
+    lookAheadCharacter.sourceLineIndex = sourceLineIndex;
+
+    if (atEOP)
+    {
+        character = READER::EOPC;                  // *OR* character = EOPC;
+    }
+    else
+    {
+        if (sourceLineIndex <= (sourceLineLength - 1))
+        {
+            character = sourceLine[sourceLineIndex];
+            sourceLineIndex += 1;
+        }
+        else
+        {
+            character = READER::EOLC;
+            ReadSourceLine();
+        }
+    }
+
+    // Only non-printable characters allowed are EOPC,'\n', and '\t', others are changed to ' '
+    if (iscntrl(character)
+        && !((character == READER::EOPC)
+            || (character == READER::EOLC)
+            || (character == READER::TABC)
+            )
+        )
+        character = ' ';
+
+    lookAheadCharacter.character = character;
+
+    if ((tracer != NULL) && tracer->IsON(TRACER::READERTRACE))
+        tracer->Log(FormatCharacterEvent, NULL,
+            nextCharacters[LOOKAHEAD].sourceLineNumber, nextCharacters[LOOKAHEAD].sourceLineIndex, character);
+
+    return(nextCharacters[0]);
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+NEXTCHARACTER READER<CALLBACKSALLOWED, LOOKAHEAD>::GetLookAheadCharacter(int index)
+//-----------------------------------------------------------
+{
+    // index in [ 0,LOOKAHEAD ] where index = 0 means last GetNextCharacter() returned
+    if ((0 <= index) && (index <= LOOKAHEAD))
+        return(nextCharacters[index]);
+    else
+        throw(AGLEXCEPTION("GetLookAheadCharacter() index out-of-range"));
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+int READER<CALLBACKSALLOWED, LOOKAHEAD>::GetCharacterSpan(const char*& span)
+//-----------------------------------------------------------
+{
+    /*
+       Bulk access for the scanner: span is set to the *raw* characters of the current
+          source line beginning with the look-ahead index = 0 character, and the number
+          of characters up to (but not including) end-of-line is returned. 0 is
+          returned when the look-ahead index = 0 character is not on the current
+          source line (look-ahead "window" straddles a line boundary, EOLC, or EOPC),
+          in which case the caller must fall back to GetNextCharacter().
+       *Note* span[] characters are not filtered, so control characters the "window"
+          would have changed to ' ' appear as-is.
+    */
+    const NEXTCHARACTER& current = nextCharacters[0];
+
+    if (atEOP
+        || (current.sourceLineNumber != sourceLineNumber)
+        || (current.character == READER::EOLC)
+        || (current.character == READER::EOPC))
+        return(0);
+    span = sourceLine + current.sourceLineIndex;
+    return(sourceLineLength - current.sourceLineIndex);
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+NEXTCHARACTER READER<CALLBACKSALLOWED, LOOKAHEAD>::SkipCharacters(int count)
+//-----------------------------------------------------------
+{
+    /*
+       Equivalent to count calls to GetNextCharacter() where count is in
+          [ 1,GetCharacterSpan() ]. Rather than shifting the look-ahead "window" once
+          per character, the line index is moved directly past the skipped characters
+          and the window is re-filled.
+    */
+    if ((tracer != NULL) && tracer->IsON(TRACER::READERTRACE))
+    {
+        // Every character is traced
+        for (int i = 1; i <= count; i++)
+            GetNextCharacter();
+    }
+    else
+    {
+        sourceLineIndex = nextCharacters[0].sourceLineIndex + count;
+        for (int i = 0; i <= LOOKAHEAD; i++)
+            GetNextCharacter();
+    }
+    return(nextCharacters[0]);
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::AddCallbackFunction(
+    void (*CallbackFunction)(int sourceLineNumber, const char sourceLine[], int sourceLineLength))
+    //-----------------------------------------------------------
+{
+    if (numberCallbacks <= CALLBACKSALLOWED)
+        CallbackFunctions[++numberCallbacks] = CallbackFunction;
+    else
+        throw(AGLEXCEPTION("Too many callback functions"));
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::AddAsynchronousCallbackFunction(
+    void (*CallbackFunction)(const SOURCELINEBATCH& batch))
+    //-----------------------------------------------------------
+{
+    /*
+       An asynchronous callback function is called on a background thread with batches
+          of source lines *after* READER has moved on, so it must not depend on
+          compiler state (use AddCallbackFunction() for that)
+    */
+    if (asynchronousCallbacks.GetCountOfCallbackFunctions() < CALLBACKSALLOWED)
+        asynchronousCallbacks.AddCallbackFunction(CallbackFunction);
+    else
+        throw(AGLEXCEPTION("Too many callback functions"));
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::FlushAsynchronousCallbacks()
+//-----------------------------------------------------------
+{
+    // Wait until every source line read so far has been given to the asynchronous callback functions
+    asynchronousCallbacks.Flush(true);
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::ReadSourceLine()
+//-----------------------------------------------------------
+{
+    /*
+       sourceLine[] is a view of sourceLineLength characters that is *NOT* necessarily
+          '\0'-terminated; it either points into lineBuffer[] (stream backend) or
+          directly into the memory-mapped source file (mapped backend).
+    */
+    STATISTICS::TIMER timer(statistics, STATISTICS::READERPHASE);
+
+    if (mappedSourceON)
+        ReadMappedSourceLine();
+    else
+        ReadStreamSourceLine();
+
+    if (!atEOP)
+    {
+        sourceLineIndex = 0;
+        if ((statistics != NULL) && statistics->IsON())
+        {
+            statistics->Count(STATISTICS::SOURCELINES);
+            statistics->Count(STATISTICS::CHARACTERS, sourceLineLength + 1);
+        }
+
+        if (lister == NULL)
+            ;
+        else if (lister->GetListingOnErrorON())
+            lister->IndexSourceLine(sourceLineNumber, sourceLineOffset);
+        else
+            lister->ListSourceLine(sourceLineNumber, sourceLine, sourceLineLength);
+
+        // Give each callback function the opportunity to process newly-read source line
+        for (int i = 1; i <= numberCallbacks; i++)
+            (*CallbackFunctions[i])(sourceLineNumber, sourceLine, sourceLineLength);
+        if (asynchronousCallbacks.GetCountOfCallbackFunctions() > 0)
+            asynchronousCallbacks.AddSourceLine(sourceLineNumber, sourceLine, sourceLineLength);
+    }
+    else
+        asynchronousCallbacks.Flush(false);
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::ReadStreamSourceLine()
+//-----------------------------------------------------------
+{
+    if (SOURCE.eof())
+        atEOP = true;
+    else
+    {
+        int length = 0;
+
+        // tellg() is only needed (and only paid for) when the lister indexes source lines
+        if ((lister != NULL) && lister->GetListingOnErrorON()) sourceLineOffset = (long long)SOURCE.tellg();
+        /*
+           getline() sets failbit (but not eofbit) when lineBuffer[] fills before '\n'
+              is found, so grow lineBuffer[] and continue reading the same line
+        */
+        SOURCE.getline(lineBuffer, lineBufferCapacity);
+        while (SOURCE.fail() && !SOURCE.eof())
+        {
+            char* biggerLineBuffer = new char[2 * lineBufferCapacity];
+
+            length += (int)SOURCE.gcount();
+            memcpy(biggerLineBuffer, lineBuffer, length);
+            delete[] lineBuffer;
+            lineBuffer = biggerLineBuffer;
+            lineBufferCapacity *= 2;
+            SOURCE.clear();
+            SOURCE.getline(&lineBuffer[length], lineBufferCapacity - length);
+        }
+        sourceLineNumber++;
+        // Erase *ALL* control characters at end of source line (if any)
+        sourceLineLength = (int)strlen(lineBuffer);
+        while ((0 <= sourceLineLength - 1) && iscntrl(lineBuffer[sourceLineLength - 1]))
+            sourceLineLength--;
+        lineBuffer[sourceLineLength] = '\0';
+        sourceLine = lineBuffer;
+    }
+}
+
+//-----------------------------------------------------------
+template<int CALLBACKSALLOWED, int LOOKAHEAD>
+void READER<CALLBACKSALLOWED, LOOKAHEAD>::ReadMappedSourceLine()
+//-----------------------------------------------------------
+{
+    /*
+       Mirror ifstream::getline() line-splitting so the mapped backend produces exactly
+          the same source lines (and NEXTCHARACTER coordinates) as the stream backend:
+          the text after the last '\n' is always one more (possibly empty) line.
+    */
+    const size_t size = mappedSourceSize;
+
+    if (mappedSourceIndex > size)
+        atEOP = true;
+    else
+    {
+        const char* begin = mappedSourceBase + mappedSourceIndex;
+        size_t remaining = size - mappedSourceIndex;
+        const char* EOL = (remaining > 0) ? (const char*)memchr(begin, '\n', remaining) : NULL;
+        size_t length = (EOL != NULL) ? (size_t)(EOL - begin) : remaining;
+
+        sourceLineNumber++;
+        sourceLineOffset = (long long)mappedSourceIndex;
+        mappedSourceIndex += length + 1;
 
-    pageNumber++;
-    LIST << FF << '"' << sourceFileName << "\" Page " << setw(4) << pageNumber << endl;
-    LIST << "Line Source Line" << endl;
-    LIST << "---- -------------------------------------------------------------------------------" << endl;
+        // Erase *ALL* control characters at end of source line (if any)
+        while ((length > 0) && iscntrl(begin[length - 1]))
+            length--;
+        sourceLine = begin;
+        sourceLineLength = (int)length;
+    }
 }
 
 //===========================================================
-struct NEXTCHARACTER
-    //===========================================================
-{
-    char character;
-    int sourceLineNumber;
-    int sourceLineIndex;
-};
-
-//===========================================================
-template <int CALLBACKSALLOWED = 5>
-class READER
+class IDENTIFIERINTERNER
     //===========================================================
 {
-public:
-    static const char EOPC = 0;
-    static const char EOLC = '\n';
-    static const char TABC = '\t';
-
+    /*
+       Gives each distinct identifier spelling a dense symbol 1, 2, ... when it is
+          first scanned (symbol 0 is the empty spelling). Spellings that differ
+          only in case share a name, also dense from 1, so identifiers compare as
+          integers. Spellings are stored '\0'-terminated in one pool.
+    */
 private:
-    const int SOURCELINELENGTH;
-    const int LOOKAHEAD;
+    struct SYMBOLRECORD
+    {
+        unsigned int spellingOffset;
+        int length;
+        int name;
+    };
 
-    char* sourceLine;
-    int sourceLineNumber;
-    int sourceLineIndex;
-    NEXTCHARACTER* nextCharacters;
-    ifstream SOURCE;
-    LISTER* lister;
-    bool atEOP;
-    int numberCallbacks;
-    void (*CallbackFunctions[CALLBACKSALLOWED + 1])
-        (int sourceLineNumber, const char sourceLine[]);
+private:
+    vector<SYMBOLRECORD> symbols;
+    vector<char> spellings;
+    vector<int> symbolSlots;      // open addressing on spelling; 0 marks an empty slot
+    vector<int> nameSlots;        // open addressing on upper-case spelling; the first symbol with the name
+    int names;
 
 public:
-    READER(const int SOURCELINELENGTH = 512, const int LOOKAHEAD = 0);
-    ~READER();
-    void OpenFile(const char sourceFileName[]);
-    void SetLister(LISTER* lister);
-    NEXTCHARACTER GetNextCharacter();
-    NEXTCHARACTER GetLookAheadCharacter(int index);
-    void AddCallbackFunction(void (*CallbackFunction)
-        (int sourceLineNumber, const char sourceLine[]));
+    IDENTIFIERINTERNER();
+    int Intern(const char lexeme[], int length);
+    int GetName(int symbol) const
+    {
+        return(symbols[symbol].name);
+    }
+    const char* GetSpelling(int symbol) const
+    {
+        return(&spellings[symbols[symbol].spellingOffset]);
+    }
+    int GetLength(int symbol) const
+    {
+        return(symbols[symbol].length);
+    }
+    int GetCountOfSymbols() const
+    {
+        return((int)symbols.size() - 1);
+    }
+    int GetCountOfNames() const
+    {
+        return(names);
+    }
+    size_t GetBytesAllocated() const
+    {
+        return(symbols.capacity() * sizeof(SYMBOLRECORD) + spellings.capacity()
+            + (symbolSlots.capacity() + nameSlots.capacity()) * sizeof(int));
+    }
+
 private:
-    void ReadSourceLine();
+    static unsigned int Hash(const char lexeme[], int length, bool isCaseFolded);
+    int FindSymbolSlot(const char lexeme[], int length, unsigned int hash) const;
+    int FindNameSlot(const char lexeme[], int length, unsigned int hash) const;
+    void Grow();
 };
 
 //-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-READER<CALLBACKSALLOWED>::READER(const int SOURCELINELENGTH, const int LOOKAHEAD) :
-    SOURCELINELENGTH(SOURCELINELENGTH), LOOKAHEAD(LOOKAHEAD)
-    //-----------------------------------------------------------
-{
-    sourceLine = new char[SOURCELINELENGTH + 2];
-    nextCharacters = new NEXTCHARACTER[LOOKAHEAD + 1];
-    sourceLineNumber = 0;
-    atEOP = false;
-    numberCallbacks = 0;
-    //   cout << "Maximum-length-source-line = " << SOURCELINELENGTH+2 << endl;
-}
-
-//-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-READER<CALLBACKSALLOWED>::~READER()
+IDENTIFIERINTERNER::IDENTIFIERINTERNER()
 //-----------------------------------------------------------
 {
-    delete[] sourceLine;
-    delete[] nextCharacters;
-    if (SOURCE.is_open()) SOURCE.close();
+    SYMBOLRECORD empty = { 0, 0, 0 };
+
+    symbols.push_back(empty);
+    spellings.push_back('\0');
+    symbolSlots.assign(256, 0);
+    nameSlots.assign(256, 0);
+    names = 0;
 }
 
 //-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-void READER<CALLBACKSALLOWED>::OpenFile(const char sourceFileName[])
+int IDENTIFIERINTERNER::Intern(const char lexeme[], int length)
 //-----------------------------------------------------------
 {
-    char fullFileName[80 + 1];
-
-    strcpy(fullFileName, sourceFileName);
-    strcat(fullFileName, ".agl");
-    SOURCE.open(fullFileName, ios::in);
-    if (!SOURCE.is_open()) throw(AGLEXCEPTION("Unable to open source file"));
+    int i = FindSymbolSlot(lexeme, length, Hash(lexeme, length, false));
 
-    // Read first source line and "fill" nextCharacters[] 
-    ReadSourceLine();
-    for (int i = 0; i <= LOOKAHEAD; i++)
+    if (symbolSlots[i] == 0)
     {
-        nextCharacters[i].character = READER::EOPC;
-        nextCharacters[i].sourceLineNumber = 0;
-        nextCharacters[i].sourceLineIndex = 0;
+        // First time this spelling is seen; give it the name of any other-case spelling
+        const int j = FindNameSlot(lexeme, length, Hash(lexeme, length, true));
+        const int symbol = (int)symbols.size();
+        SYMBOLRECORD record = { (unsigned int)spellings.size(), length,
+            (nameSlots[j] == 0) ? ++names : symbols[nameSlots[j]].name };
+
+        symbols.push_back(record);
+        spellings.insert(spellings.end(), lexeme, lexeme + length);
+        spellings.push_back('\0');
+        symbolSlots[i] = symbol;
+        if (nameSlots[j] == 0) nameSlots[j] = symbol;
+
+        // Keep both tables at most half full
+        if (2 * symbols.size() > symbolSlots.size()) Grow();
+        return(symbol);
     }
-    for (int i = 0; i <= LOOKAHEAD; i++)
-        GetNextCharacter();
+    return(symbolSlots[i]);
 }
 
 //-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-void READER<CALLBACKSALLOWED>::SetLister(LISTER* lister)
+unsigned int IDENTIFIERINTERNER::Hash(const char lexeme[], int length, bool isCaseFolded)
 //-----------------------------------------------------------
 {
-    this->lister = lister;
+    // FNV-1a
+    unsigned int h = 2166136261U;
+
+    for (int k = 0; k <= length - 1; k++)
+        h = (h ^ (unsigned char)(isCaseFolded ? toupper(lexeme[k]) : lexeme[k])) * 16777619U;
+    return(h);
 }
 
 //-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-NEXTCHARACTER READER<CALLBACKSALLOWED>::GetNextCharacter()
+int IDENTIFIERINTERNER::FindSymbolSlot(const char lexeme[], int length, unsigned int hash) const
 //-----------------------------------------------------------
 {
-    char character;
-
-    // Move look-ahead "window" to make room for next character
-    for (int i = 1; i <= LOOKAHEAD; i++)
-        nextCharacters[i - 1] = nextCharacters[i];
-
-    nextCharacters[LOOKAHEAD].sourceLineNumber = sourceLineNumber;
-    nextCharacters[LOOKAHEAD].sourceLineIndex = sourceLineIndex;
+    // The slot holding lexeme's symbol, or the empty slot where it belongs
+    const int mask = (int)symbolSlots.size() - 1;
+    int i = (int)(hash & (unsigned int)mask);
 
-    if (atEOP)
-    {
-        character = READER::EOPC;                  // *OR* character = EOPC;
-    }
-    else
+    while (symbolSlots[i] != 0)
     {
-        if (sourceLineIndex <= ((int)strlen(sourceLine) - 1))
-        {
-            character = sourceLine[sourceLineIndex];
-            sourceLineIndex += 1;
-        }
-        else
-        {
-            character = READER::EOLC;
-            ReadSourceLine();
-        }
-    }
-
-    // Only non-printable characters allowed are EOPC,'\n', and '\t', others are changed to ' '
-    if (iscntrl(character)
-        && !((character == READER::EOPC)
-            || (character == READER::EOLC)
-            || (character == READER::TABC)
-            )
-        )
-        character = ' ';
+        const SYMBOLRECORD& record = symbols[symbolSlots[i]];
 
-    nextCharacters[LOOKAHEAD].character = character;
-
-#ifdef TRACEREADER
-    {
-        char information[80 + 1];
-
-        if (isprint(character))
-            sprintf(information, "At (%4d:%3d) %02X = %c",
-                nextCharacters[LOOKAHEAD].sourceLineNumber,
-                nextCharacters[LOOKAHEAD].sourceLineIndex,
-                character, character);
-        else if (character == READER::EOPC)
-            sprintf(information, "At (%4d:%3d) %02X = EOPC",
-                nextCharacters[LOOKAHEAD].sourceLineNumber,
-                nextCharacters[LOOKAHEAD].sourceLineIndex,
-                character);
-        else if (character == READER::EOLC)
-            sprintf(information, "At (%4d:%3d) %02X = EOLC",
-                nextCharacters[LOOKAHEAD].sourceLineNumber,
-                nextCharacters[LOOKAHEAD].sourceLineIndex,
-                character);
-        else if (character == READER::TABC)
-            sprintf(information, "At (%4d:%3d) %02X = TABC",
-                nextCharacters[LOOKAHEAD].sourceLineNumber,
-                nextCharacters[LOOKAHEAD].sourceLineIndex,
-                character);
-        else
-            sprintf(information, "At (%4d:%3d) %02X = ???",
-                nextCharacters[LOOKAHEAD].sourceLineNumber,
-                nextCharacters[LOOKAHEAD].sourceLineIndex,
-                character);
-        lister->ListInformationLine(information);
+        if ((record.length == length) && (memcmp(&spellings[record.spellingOffset], lexeme, length) == 0))
+            break;
+        i = (i + 1) & mask;
     }
-#endif
-
-    return(nextCharacters[0]);
+    return(i);
 }
 
 //-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-NEXTCHARACTER READER<CALLBACKSALLOWED>::GetLookAheadCharacter(int index)
+int IDENTIFIERINTERNER::FindNameSlot(const char lexeme[], int length, unsigned int hash) const
 //-----------------------------------------------------------
 {
-    // index in [ 0,LOOKAHEAD ] where index = 0 means last GetNextCharacter() returned
-    if ((0 <= index) && (index <= LOOKAHEAD))
-        return(nextCharacters[index]);
-    else
-        throw(AGLEXCEPTION("GetLookAheadCharacter() index out-of-range"));
-}
+    // The slot holding a symbol spelled like lexeme ignoring case, or the empty slot where one belongs
+    const int mask = (int)nameSlots.size() - 1;
+    int i = (int)(hash & (unsigned int)mask);
 
-//-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-void READER<CALLBACKSALLOWED>::AddCallbackFunction(
-    void (*CallbackFunction)(int sourceLineNumber, const char sourceLine[]))
-    //-----------------------------------------------------------
-{
-    if (numberCallbacks <= CALLBACKSALLOWED)
-        CallbackFunctions[++numberCallbacks] = CallbackFunction;
-    else
-        throw(AGLEXCEPTION("Too many callback functions"));
+    while (nameSlots[i] != 0)
+    {
+        const SYMBOLRECORD& record = symbols[nameSlots[i]];
+
+        if (record.length == length)
+        {
+            const char* spelling = &spellings[record.spellingOffset];
+            int k = 0;
+
+            while ((k <= length - 1) && (toupper(spelling[k]) == toupper(lexeme[k])))
+                k++;
+            if (k == length) break;
+        }
+        i = (i + 1) & mask;
+    }
+    return(i);
 }
 
 //-----------------------------------------------------------
-template<int CALLBACKSALLOWED>
-void READER<CALLBACKSALLOWED>::ReadSourceLine()
+void IDENTIFIERINTERNER::Grow()
 //-----------------------------------------------------------
 {
-    if (SOURCE.eof())
-        atEOP = true;
-    else
+    vector<bool> isNamePlaced(names + 1, false);
+
+    symbolSlots.assign(2 * symbolSlots.size(), 0);
+    nameSlots.assign(2 * nameSlots.size(), 0);
+    for (int symbol = 1; symbol <= (int)symbols.size() - 1; symbol++)
     {
-        SOURCE.getline(sourceLine, SOURCELINELENGTH + 2);
-        sourceLineNumber++;
-        if (SOURCE.fail() && !SOURCE.eof())
+        const SYMBOLRECORD& record = symbols[symbol];
+        const char* spelling = &spellings[record.spellingOffset];
+
+        symbolSlots[FindSymbolSlot(spelling, record.length, Hash(spelling, record.length, false))] = symbol;
+        if (!isNamePlaced[record.name])
         {
-            lister->ListInformationLine("******* Source line too long!");
-            SOURCE.clear();
+            nameSlots[FindNameSlot(spelling, record.length, Hash(spelling, record.length, true))] = symbol;
+            isNamePlaced[record.name] = true;
         }
-        // Erase *ALL* control characters at end of source line (if any)
-        strcat(sourceLine, "\n");
-        while ((0 <= (int)strlen(sourceLine) - 1) &&
-            iscntrl(sourceLine[(int)strlen(sourceLine) - 1]))
-            sourceLine[(int)strlen(sourceLine) - 1] = '\0';
-        sourceLineIndex = 0;
+    }
+}
 
-        lister->ListSourceLine(sourceLineNumber, sourceLine);
+//===========================================================
+class TEXTARENA
+    //===========================================================
+{
+    /*
+       Append-only store for texts that are never looked up by spelling (CODE's
+          comments and unformatted lines, nearly all of them distinct). Each text
+          gets the next ID 1, 2, ... (ID 0 is "") and is stored '\0'-terminated in
+          one pool; unlike IDENTIFIERINTERNER nothing is hashed, so a text costs
+          its characters and one int.
+    */
+private:
+    vector<unsigned int> textEnds;   // text i is characters[ textEnds[i-1],textEnds[i]-1 ) plus its '\0'
+    vector<char> characters;
 
-        // Give each callback function the opportunity to process newly-read source line
-        for (int i = 1; i <= numberCallbacks; i++)
-            (*CallbackFunctions[i])(sourceLineNumber, sourceLine);
+public:
+    TEXTARENA()
+    {
+        characters.push_back('\0');
+        textEnds.push_back(1);
     }
-}
+    int Append(const char text[], int length)
+    {
+        characters.insert(characters.end(), text, text + length);
+        characters.push_back('\0');
+        textEnds.push_back((unsigned int)characters.size());
+        return((int)textEnds.size() - 1);
+    }
+    const char* GetText(int text) const
+    {
+        return(&characters[(text == 0) ? 0 : textEnds[text - 1]]);
+    }
+    int GetLength(int text) const
+    {
+        return((int)(textEnds[text] - ((text == 0) ? 0 : textEnds[text - 1])) - 1);
+    }
+    size_t GetBytesAllocated() const
+    {
+        return(textEnds.capacity() * sizeof(unsigned int) + characters.capacity());
+    }
+};
 
 //===========================================================
 class IDENTIFIERTABLE
@@ -425,14 +2408,18 @@ private:
     struct IDENTIFIERRECORD
     {
         int scope;
-        char lexeme[MAXIMUMLENGTHIDENTIFIER + 1];
-        IDENTIFIERTYPE identifierType;
-        char reference[MAXIMUMLENGTHIDENTIFIER + 1];
-        DATATYPE datatype;
+        int symbol;           // spelling (see IDENTIFIERINTERNER)
+        int name;             // 0 when the identifier must not be found
+        int shadowedIndex;    // next-most-recent identifier with the same name (0 = none)
+        unsigned int referenceOffset;
+        unsigned char identifierType;
+        unsigned char datatype;
         //--------------------------------------------------
         // ADDED FOR SPL8
         //--------------------------------------------------
         int dimensions;
+        int parameters;       // subprogram module: count of formal parameters (they follow it)
+                              // formal parameter: position 1, 2, ... in its module's list
     };
 
 private:
@@ -440,25 +2427,41 @@ private:
     static const char DATATYPENAMES[][9 + 1];
 
 private:
-    int capacity;
     int identifiers;
-    IDENTIFIERRECORD* identifierTable;
+    vector<IDENTIFIERRECORD> identifierTable;   // [0] is unused; records past identifiers are re-used
+    vector<char> references;                    // '\0'-terminated, in record order (see AddToTable())
     int scopes;
-    int* scopeTable;
+    vector<int> scopeTable;
+    vector<int> nameIndexes;      // [name] = index of the visible identifier with that name (0 = none)
     LISTER* lister;
+    TRACER* tracer;
+    STATISTICS* statistics;
+    const IDENTIFIERINTERNER* interner;
 
 public:
-    IDENTIFIERTABLE(LISTER* lister, int capacity);
-    ~IDENTIFIERTABLE();
-    int GetIndex(const char lexeme[], bool& isInTable);
+    IDENTIFIERTABLE(LISTER* lister, const IDENTIFIERINTERNER* interner, int initialCapacity);
+    int GetIndex(int symbol, bool& isInTable);
     //--------------------------------------------------
     // MODIFIED FOR SPL8
     //--------------------------------------------------
-    void AddToTable(const char lexeme[], IDENTIFIERTYPE identifierType,
+    void AddToTable(int symbol, IDENTIFIERTYPE identifierType,
         DATATYPE datatype, const char reference[], int dimensions = 0);
     void EnterNestedStaticScope();
     void ExitNestedStaticScope();
     void DisplayTableContents(const char description[]);
+    void SetTracer(TRACER* tracer)
+    {
+        this->tracer = tracer;
+    }
+    void SetStatistics(STATISTICS* statistics)
+    {
+        this->statistics = statistics;
+    }
+    size_t GetBytesAllocated() const
+    {
+        return(identifierTable.capacity() * sizeof(IDENTIFIERRECORD) + references.capacity()
+            + (scopeTable.capacity() + nameIndexes.capacity()) * sizeof(int));
+    }
 
     /*
        Assume index was determined by a prior successful call to GetIndex() as
@@ -474,24 +2477,42 @@ public:
     }
     IDENTIFIERTYPE GetType(int index)
     {
-        return(identifierTable[index].identifierType);
+        return((IDENTIFIERTYPE)identifierTable[index].identifierType);
     }
-    char* GetLexeme(int index)
+    const char* GetLexeme(int index)
     {
-        return(identifierTable[index].lexeme);
+        return(interner->GetSpelling(identifierTable[index].symbol));
     }
-    char* GetReference(int index)
+    const char* GetReference(int index)
     {
-        return(identifierTable[index].reference);
+        return(&references[identifierTable[index].referenceOffset]);
     }
     DATATYPE GetDatatype(int index)
     {
-        return(identifierTable[index].datatype);
+        return((DATATYPE)identifierTable[index].datatype);
     }
     //--------------------------------------------------
     // ADDED FOR SPL6
     //--------------------------------------------------
     int GetCountOfFormalParameters(int index);
+    /*
+       A subprogram module's signature: its formal parameters are the identifiers
+          at indexes firstParameterIndex, firstParameterIndex+1, ... (their types
+          are the parameter modes) and a FUNCTION's return type is its datatype.
+    */
+    struct SIGNATURE
+    {
+        int firstParameterIndex;
+        int parameters;
+        DATATYPE returnDatatype;
+    };
+    SIGNATURE GetSignature(int index)
+    {
+        SIGNATURE signature = { index + 1, identifierTable[index].parameters,
+            (DATATYPE)identifierTable[index].datatype };
+
+        return(signature);
+    }
     //--------------------------------------------------
     // ADDED FOR SPL8
     //--------------------------------------------------
@@ -499,6 +2520,21 @@ public:
     {
         return(identifierTable[index].dimensions);
     }
+
+private:
+    static void FormatGetIndexEvent(const TRACEEVENT& event, char information[]);
+    static void FormatAddToTableEvent(const TRACEEVENT& event, char information[]);
+    static void FormatScopeEvent(const TRACEEVENT& event, char information[]);
+    static void FormatFormalParametersEvent(const TRACEEVENT& event, char information[]);
+    static bool IsSubprogramModule(int identifierType)
+    {
+        return((identifierType == PROCEDURE_SUBPROGRAMMODULE) || (identifierType == FUNCTION_SUBPROGRAMMODULE));
+    }
+    static bool IsFormalParameter(int identifierType)
+    {
+        return((identifierType == IN_PARAMETER) || (identifierType == OUT_PARAMETER) ||
+            (identifierType == IO_PARAMETER) || (identifierType == REF_PARAMETER));
+    }
 };
 
 //-----------------------------------------------------------
@@ -539,72 +2575,64 @@ const char IDENTIFIERTABLE::DATATYPENAMES[][9 + 1] =
 };
 
 //-----------------------------------------------------------
-IDENTIFIERTABLE::IDENTIFIERTABLE(LISTER* lister, int capacity)
+IDENTIFIERTABLE::IDENTIFIERTABLE(LISTER* lister, const IDENTIFIERINTERNER* interner, int initialCapacity)
 //-----------------------------------------------------------
 {
+    // The table grows as needed; initialCapacity only sizes the first allocation
+    IDENTIFIERRECORD unused = { 0, 0, 0, 0, 0, GLOBAL_VARIABLE, NOTYPE, 0, 0 };
+
     this->lister = lister;
-    this->capacity = capacity;
-    identifierTable = new IDENTIFIERRECORD[capacity + 1];
+    this->interner = interner;
+    tracer = NULL;
+    statistics = NULL;
+    identifierTable.reserve(initialCapacity + 1);
+    identifierTable.push_back(unused);
+    references.reserve(initialCapacity * 8);
+    references.push_back('\0');
     identifiers = 0;
-    scopeTable = new int[capacity + 1];
+    scopeTable.push_back(0);
     scopes = 0;
 }
 
 //-----------------------------------------------------------
-IDENTIFIERTABLE::~IDENTIFIERTABLE()
-//-----------------------------------------------------------
-{
-    delete[] identifierTable;
-    delete[] scopeTable;
-}
-
-//-----------------------------------------------------------
-int IDENTIFIERTABLE::GetIndex(const char lexeme[], bool& isInTable)
+int IDENTIFIERTABLE::GetIndex(int symbol, bool& isInTable)
 //-----------------------------------------------------------
 {
     /*
-       Try to find identifier's lexeme in identifier table working from the end of
-          the table toward the beginning.
+       Find the identifier with symbol's name (its case-insensitive spelling) that is
+          nearest the end of the identifier table. nameIndexes[] always holds that
+          index, so no searching is needed.
     */
-    char UCLexeme1[SOURCELINELENGTH + 1], UCLexeme2[SOURCELINELENGTH];
+    STATISTICS::TIMER timer(statistics, STATISTICS::IDENTIFIERTABLEPHASE);
+    const int name = interner->GetName(symbol);
     int index;
-    bool isInCurrentScope;
+    bool isInCurrentScope = false;
 
-    for (int i = 0; i <= (int)strlen(lexeme); i++)
-        UCLexeme1[i] = toupper(lexeme[i]);
-    isInTable = false;
-    index = identifiers;
-    while ((index >= 1) && !isInTable)
+    index = (name <= (int)nameIndexes.size() - 1) ? nameIndexes[name] : 0;
+    isInTable = (index != 0);
+    if (isInTable)
+        isInCurrentScope = (identifierTable[index].scope == scopes);
+
+    // A hit's depth is how many scopes out from the current scope the identifier was found
+    if ((statistics != NULL) && statistics->IsON())
     {
-        for (int i = 0; i <= (int)strlen(identifierTable[index].lexeme); i++)
-            UCLexeme2[i] = toupper(identifierTable[index].lexeme[i]);
-        if (strcmp(UCLexeme1, UCLexeme2) == 0)
+        statistics->Count(STATISTICS::LOOKUPS);
+        if (isInTable)
         {
-            isInTable = true;
-            isInCurrentScope = (identifierTable[index].scope == scopes);
+            statistics->Count(STATISTICS::LOOKUPHITS);
+            statistics->Count((STATISTICS::COUNTER)(STATISTICS::LOOKUPHITSDEPTH0
+                + min(scopes - identifierTable[index].scope, 3)));
         }
-        else
-            index -= 1;
     }
 
-#ifdef TRACEIDENTIFIERTABLE
-    {
-        char information[SOURCELINELENGTH + 1];
-
-        if (isInTable)
-            sprintf(information, "Found identifier \"%s\" at index = %d (%s)",
-                lexeme, index, ((isInCurrentScope) ? "is in current scope" : "not in current scope"));
-        else
-            sprintf(information, "Did not find identifier \"%s\"", lexeme);
-        lister->ListInformationLine(information);
-    }
-#endif
+    if ((tracer != NULL) && tracer->IsON(TRACER::IDENTIFIERTABLETRACE))
+        tracer->Log(FormatGetIndexEvent, this, symbol, index, isInTable, isInTable && isInCurrentScope);
 
     return(index);
 }
 
 //-----------------------------------------------------------
-void IDENTIFIERTABLE::AddToTable(const char lexeme[], IDENTIFIERTYPE identifierType,
+void IDENTIFIERTABLE::AddToTable(int symbol, IDENTIFIERTYPE identifierType,
     DATATYPE datatype, const char reference[], int dimensions /* = 0*/)
     //-----------------------------------------------------------
 {
@@ -612,31 +2640,49 @@ void IDENTIFIERTABLE::AddToTable(const char lexeme[], IDENTIFIERTYPE identifierT
        Assumes a prior reference to GetIndex() has already guaranteed that the
           identifier being added is *NOT* in the identifier table
     */
-    if (identifiers > capacity)
-        throw(AGLEXCEPTION("Identifier table capacity exceeded"));
-    else
+    // The table grows as needed; a record's reference is stored after the reference of the record before it
+    STATISTICS::TIMER timer(statistics, STATISTICS::IDENTIFIERTABLEPHASE);
+    const IDENTIFIERRECORD& previous = identifierTable[identifiers];
+    const size_t referenceOffset = previous.referenceOffset + strlen(&references[previous.referenceOffset]) + 1;
+    int name;
+
+    identifiers++;
+    if (identifiers > (int)identifierTable.size() - 1) identifierTable.push_back(identifierTable[0]);
+    references.resize(referenceOffset);
+    references.insert(references.end(), reference, reference + strlen(reference) + 1);
+    identifierTable[identifiers].scope = scopes;
+    identifierTable[identifiers].symbol = symbol;
+    identifierTable[identifiers].name = name = interner->GetName(symbol);
+    identifierTable[identifiers].referenceOffset = (unsigned int)referenceOffset;
+    identifierTable[identifiers].identifierType = (unsigned char)identifierType;
+    identifierTable[identifiers].datatype = (unsigned char)datatype;
+    identifierTable[identifiers].dimensions = dimensions;
+    identifierTable[identifiers].parameters = 0;
+
+    // A formal parameter extends the list of the subprogram module (or parameter) just before it
+    if (IsFormalParameter(identifierType))
     {
-        identifiers++;
-        identifierTable[identifiers].scope = scopes;
-        strncpy(identifierTable[identifiers].lexeme, lexeme, MAXIMUMLENGTHIDENTIFIER);
-        identifierTable[identifiers].identifierType = identifierType;
-        strcpy(identifierTable[identifiers].reference, reference);
-        identifierTable[identifiers].datatype = datatype;
-        identifierTable[identifiers].dimensions = dimensions;
-    }
+        const IDENTIFIERRECORD& before = identifierTable[identifiers - 1];
 
-#ifdef TRACEIDENTIFIERTABLE
-    {
-        char information[SOURCELINELENGTH + 1];
+        if (IsSubprogramModule(before.identifierType) || (IsFormalParameter(before.identifierType) && (before.parameters != 0)))
+        {
+            const int position = IsSubprogramModule(before.identifierType) ? 1 : before.parameters + 1;
 
-        sprintf(information, "Added identifier \"%s\" at index = %d, reference = %s, identifier type = %s, data type = %s, dimensions = %d",
-            lexeme, identifiers, identifierTable[identifiers].reference,
-            IDENTIFIERTYPENAMES[identifierTable[identifiers].identifierType],
-            DATATYPENAMES[identifierTable[identifiers].datatype],
-            dimensions);
-        lister->ListInformationLine(information);
+            identifierTable[identifiers].parameters = position;
+            identifierTable[identifiers - position].parameters = position;
+        }
     }
-#endif
+
+    // The new identifier shadows any other with its name
+    if (name >= (int)nameIndexes.size()) nameIndexes.resize(interner->GetCountOfNames() + 1, 0);
+    identifierTable[identifiers].shadowedIndex = nameIndexes[name];
+    nameIndexes[name] = identifiers;
+
+    if ((statistics != NULL) && statistics->IsON())
+        statistics->Count(STATISTICS::IDENTIFIERSADDED);
+    if ((tracer != NULL) && tracer->IsON(TRACER::IDENTIFIERTABLETRACE))
+        tracer->Log(FormatAddToTableEvent, this, symbol, identifiers,
+            identifierType + 256 * datatype, dimensions, reference);
 
 }
 
@@ -644,17 +2690,11 @@ void IDENTIFIERTABLE::AddToTable(const char lexeme[], IDENTIFIERTYPE identifierT
 void IDENTIFIERTABLE::EnterNestedStaticScope()
 //--------------------------------------------------
 {
-    scopeTable[++scopes] = identifiers;
-
-#ifdef TRACEIDENTIFIERTABLE
-    {
-        char information[SOURCELINELENGTH + 1];
+    if (++scopes > (int)scopeTable.size() - 1) scopeTable.push_back(0);
+    scopeTable[scopes] = identifiers;
 
-        sprintf(information, "Begin nested scope #%d, identifier table index = %d",
-            scopes, identifiers);
-        lister->ListInformationLine(information);
-    }
-#endif
+    if ((tracer != NULL) && tracer->IsON(TRACER::IDENTIFIERTABLETRACE))
+        tracer->Log(FormatScopeEvent, this, scopes, identifiers, true);
 
 }
 
@@ -672,13 +2712,21 @@ void IDENTIFIERTABLE::ExitNestedStaticScope()
           *Note* The subprogram module identifier is retained because it is in the
           scope just re-entered.
     */
+    STATISTICS::TIMER timer(statistics, STATISTICS::IDENTIFIERTABLEPHASE);
+    const int lastIdentifier = identifiers;
+
+    // Uncover the identifiers that the scope's identifiers (most recent first) shadowed
+    for (int index = identifiers; index >= scopeTable[scopes] + 1; index--)
+        if (identifierTable[index].name != 0)
+            nameIndexes[identifierTable[index].name] = identifierTable[index].shadowedIndex;
     identifiers = scopeTable[scopes--];
-    if ((identifierTable[identifiers].identifierType == PROCEDURE_SUBPROGRAMMODULE) ||
-        (identifierTable[identifiers].identifierType == FUNCTION_SUBPROGRAMMODULE))
-        while ((identifierTable[identifiers + 1].identifierType == IN_PARAMETER) ||
-            (identifierTable[identifiers + 1].identifierType == OUT_PARAMETER) ||
-            (identifierTable[identifiers + 1].identifierType == IO_PARAMETER) ||
-            (identifierTable[identifiers + 1].identifierType == REF_PARAMETER))
+
+    // Records past the scope's last identifier are left over from earlier scopes
+    if (IsSubprogramModule(identifierTable[identifiers].identifierType))
+    {
+        const int lastParameter = min(identifiers + identifierTable[identifiers].parameters, lastIdentifier);
+
+        while (identifiers + 1 <= lastParameter)
         {
             identifiers++;
             /*
@@ -686,18 +2734,22 @@ void IDENTIFIERTABLE::ExitNestedStaticScope()
                   not found when out-of-scope, but still allows identifier type to
                   remain available for subprogram reference semantic analysis.
             */
-            identifierTable[identifiers].lexeme[0] = '\0';
+            identifierTable[identifiers].symbol = 0;
+            identifierTable[identifiers].name = 0;
         }
+    }
 
-#ifdef TRACEIDENTIFIERTABLE
+    // Formal parameters cut from the table also leave their subprogram module's list
+    for (int index = lastIdentifier; index >= identifiers + 1; index--)
     {
-        char information[SOURCELINELENGTH + 1];
+        const int position = identifierTable[index].parameters;
 
-        sprintf(information, "End nested scope #%d, identifier table index now = %d",
-            scopes + 1, identifiers);
-        lister->ListInformationLine(information);
+        if (IsFormalParameter(identifierTable[index].identifierType) && (position != 0) && (index - position <= identifiers))
+            identifierTable[index - position].parameters = position - 1;
     }
-#endif
+
+    if ((tracer != NULL) && tracer->IsON(TRACER::IDENTIFIERTABLETRACE))
+        tracer->Log(FormatScopeEvent, this, scopes + 1, identifiers, false);
 
 }
 
@@ -732,8 +2784,8 @@ void IDENTIFIERTABLE::DisplayTableContents(const char description[])
             ((identifierTable[i].datatype == NOTYPE) ? " " : DATATYPENAMES[identifierTable[i].datatype]),
             identifierTable[i].dimensions,
             IDENTIFIERTYPENAMES[identifierTable[i].identifierType],
-            identifierTable[i].reference,
-            identifierTable[i].lexeme);
+            GetReference(i),
+            interner->GetSpelling(identifierTable[i].symbol));
         lister->ListInformationLine(information);
     }
     lister->ListInformationLine
@@ -743,39 +2795,75 @@ void IDENTIFIERTABLE::DisplayTableContents(const char description[])
 //--------------------------------------------------
 // ADDED FOR SPL6
 //--------------------------------------------------
-int IDENTIFIERTABLE::GetCountOfFormalParameters(int index)
+int IDENTIFIERTABLE::GetCountOfFormalParameters(int index)
+//--------------------------------------------------
+{
+    /*
+       Assumes compiler has verified that
+          (1) index represents a subprogram module identifier; and
+          (2) all the subprogram module formal parameters immediately follow the
+              subprogram module identifier in identifier table
+       AddToTable() keeps the count in the subprogram module's record.
+    */
+    int count = identifierTable[index].parameters;
+
+    if ((tracer != NULL) && tracer->IsON(TRACER::IDENTIFIERTABLETRACE))
+        tracer->Log(FormatFormalParametersEvent, this, identifierTable[index].symbol, count);
+
+    return(count);
+}
+
+//--------------------------------------------------
+void IDENTIFIERTABLE::FormatGetIndexEvent(const TRACEEVENT& event, char information[])
+//--------------------------------------------------
+{
+    // values[] = { symbol, index, isInTable, isInCurrentScope }
+    const IDENTIFIERTABLE* table = (const IDENTIFIERTABLE*)event.context;
+
+    if (event.values[2])
+        sprintf(information, "Found identifier \"%s\" at index = %d (%s)",
+            table->interner->GetSpelling(event.values[0]), event.values[1],
+            ((event.values[3]) ? "is in current scope" : "not in current scope"));
+    else
+        sprintf(information, "Did not find identifier \"%s\"", table->interner->GetSpelling(event.values[0]));
+}
+
+//--------------------------------------------------
+void IDENTIFIERTABLE::FormatAddToTableEvent(const TRACEEVENT& event, char information[])
+//--------------------------------------------------
+{
+    // values[] = { symbol, index, identifierType + 256 * datatype, dimensions }, text = reference
+    const IDENTIFIERTABLE* table = (const IDENTIFIERTABLE*)event.context;
+
+    sprintf(information, "Added identifier \"%s\" at index = %d, reference = %s, identifier type = %s, data type = %s, dimensions = %d",
+        table->interner->GetSpelling(event.values[0]), event.values[1], event.text,
+        IDENTIFIERTYPENAMES[event.values[2] % 256],
+        DATATYPENAMES[event.values[2] / 256],
+        event.values[3]);
+}
+
+//--------------------------------------------------
+void IDENTIFIERTABLE::FormatScopeEvent(const TRACEEVENT& event, char information[])
+//--------------------------------------------------
+{
+    // values[] = { scope, identifiers, isBegin }
+    if (event.values[2])
+        sprintf(information, "Begin nested scope #%d, identifier table index = %d",
+            event.values[0], event.values[1]);
+    else
+        sprintf(information, "End nested scope #%d, identifier table index now = %d",
+            event.values[0], event.values[1]);
+}
+
+//--------------------------------------------------
+void IDENTIFIERTABLE::FormatFormalParametersEvent(const TRACEEVENT& event, char information[])
 //--------------------------------------------------
 {
-    /*
-       Assumes compiler has verified that
-          (1) index represents a subprogram module identifier; and
-          (2) all the subprogram module formal parameters immediately follow the
-              subprogram module identifier in identifier table
-    */
-    int count;
-
-    index++;
-    count = 0;
-    while ((identifierTable[index].identifierType == IN_PARAMETER) ||
-        (identifierTable[index].identifierType == OUT_PARAMETER) ||
-        (identifierTable[index].identifierType == IO_PARAMETER) ||
-        (identifierTable[index].identifierType == REF_PARAMETER))
-    {
-        count++;
-        index++;
-    }
-
-#ifdef TRACEIDENTIFIERTABLE
-    {
-        char information[SOURCELINELENGTH + 1];
-
-        sprintf(information, "Subprogram module \"%s\" has %d formal parameters",
-            identifierTable[index].lexeme, count);
-        lister->ListInformationLine(information);
-    }
-#endif
+    // values[] = { symbol, count }
+    const IDENTIFIERTABLE* table = (const IDENTIFIERTABLE*)event.context;
 
-    return(count);
+    sprintf(information, "Subprogram module \"%s\" has %d formal parameters",
+        table->interner->GetSpelling(event.values[0]), event.values[1]);
 }
 
 //===========================================================
@@ -793,25 +2881,112 @@ class CODE
           local variables/constants--have storage space accounted for when their
           definitions are parsed. The frame space is then allocated using STM
           statements emitted as part of the subprogram module prolog code.
+
+       Emitted lines are not written as they are emitted. Each one is kept as an
+          INSTRUCTION--opcode, typed operand, and the IDs of its label and comment
+          text--in instructions[], and the list is written to the .stm file by
+          EmitEndingCode() (or by Flush() when compilation ends with an error).
+          Flush() lays out the tab-stop columns itself (no sprintf()) in a large
+          buffer that is written only when it fills, so the .stm file is written
+          with a few large writes instead of being flushed once per line.
+       Static data and frame data are kept the same way, as INSTRUCTIONs whose
+          strings and comments live in texts, until they are emitted.
+
+       With the peephole optimizer ON each emitted instruction is checked against
+          the rules in PEEPHOLEPATTERNS[]; a rule whose pattern ends at that instruction
+          may rewrite the last few instructions (comment lines in between are skipped
+          and kept), and the rules are tried again on the result. Rules never remove
+          a label definition; a labeled instruction that is removed is left behind
+          as "label EQU *".
     */
+public:
+    // STM opcodes (and directives) in alphabetical order of their mnemonics
+    enum OPCODE
+    {
+        STM_NONE,             // no mnemonic
+        STM_ADDI, STM_AND, STM_CALL, STM_CMPI, STM_DISCARD, STM_DIVI, STM_DS, STM_DW,
+        STM_EQU, STM_JMP, STM_JMPE, STM_JMPG, STM_JMPGE, STM_JMPL, STM_JMPLE, STM_JMPNE,
+        STM_JMPNN, STM_JMPNT, STM_JMPT, STM_MAKEDUP, STM_MULI, STM_NAND, STM_NEGI, STM_NOR,
+        STM_NOT, STM_OR, STM_ORG, STM_POP, STM_POPSB, STM_POPSP, STM_POWI, STM_PUSH,
+        STM_PUSHA, STM_REMI, STM_RETURN, STM_RW, STM_SETNZPI, STM_SETT, STM_SUBI, STM_SVC,
+        STM_SWAP, STM_XOR,
+        STM_COMMENTLINE,      // a comment (its comment) in place of the mnemonic
+        STM_UNFORMATTEDLINE,  // EmitUnformattedLine() text (its comment)
+        OPCODES
+    };
+    enum OPERANDKIND
+    {
+        NOOPERAND,
+        IMMEDIATEOPERAND,     // #0Dvalue
+        HEXIMMEDIATEOPERAND,  // #0Xhhhh (value)
+        SYMBOLIMMEDIATEOPERAND, // #symbol (text ID)
+        CONSTANTOPERAND,      // 0Dvalue
+        SBOPERAND,            // SB:0Doffset
+        FBOPERAND,            // FB:0Doffset
+        SPOPERAND,            // SP:0Doffset
+        INDIRECTSPOPERAND,    // @SP:0Doffset
+        LABELOPERAND,         // label (text ID)
+        LOCATIONOPERAND,      // * (the location counter)
+        STRINGOPERAND,        // "string" (text ID of the characters between the quotes)
+        TEXTOPERAND           // anything else, verbatim (text ID)
+    };
+    struct INSTRUCTION
+    {
+        unsigned char opcode;          // OPCODE
+        unsigned char operandKind;     // OPERANDKIND
+        int operand;                   // value, offset, or text ID (see OPERANDKIND)
+        int label;                     // text ID of the label defined by the line (0 = none)
+        int comment;                   // comment ID in comments (0 = none)
+        int sourceLineNumber;          // the source line most recently read
+    };
+    enum PEEPHOLERULE
+    {
+        STOREANDDISCARDRULE,           // MAKEDUP; POP @SP:0D2; SWAP; DISCARD #0D1; DISCARD #0D1
+        STOREDIRECTRULE,               // PUSHA x; PUSH y; POP @SP:0D1; DISCARD #0D1
+        PUSHPOPRULE,                   // PUSH x; POP x
+        BRANCHIFFALSERULE,             // JMPcc T; PUSH #0X0000; JMP E; T PUSH #0XFFFF; E EQU *; SETT; DISCARD #0D1; JMPNT L
+        BRANCHIFTRUERULE,              // ... JMPT L
+        PEEPHOLERULES
+    };
+
 private:
-    struct DATARECORD
+    static const char MNEMONICS[][7 + 1];
+    static const int BUFFERSIZE = 1024 * 1024;
+    static const int MAXIMUMPEEPHOLELENGTH = 8;
+
+    struct PEEPHOLEPATTERN
     {
-        char mnemonic[SOURCELINELENGTH + 1];
-        char operand[SOURCELINELENGTH + 1];
-        char comment[SOURCELINELENGTH + 1];
+        char name[31 + 1];
+        int length;                                   // instructions matched
+        unsigned char opcodes[MAXIMUMPEEPHOLELENGTH]; // STM_NONE matches any opcode (ApplyPeepholeRule() checks it)
     };
+    static const PEEPHOLEPATTERN PEEPHOLEPATTERNS[PEEPHOLERULES];
 
 private:
     ofstream STM;
     char codeFileName[80 + 1];
-    vector<DATARECORD> staticdata;
+    STATISTICS* statistics;
+    vector<INSTRUCTION> instructions;   // emitted but not yet written
+    IDENTIFIERINTERNER texts;           // labels, strings, and other operand text; ID 0 is ""
+    TEXTARENA comments;                 // comments and unformatted lines (never looked up); ID 0 is ""
+    string operandText;
+    int sourceLineNumber;
+    char* buffer;
+    int bufferLength;
+    vector<INSTRUCTION> staticdata;      // RW, DW, and DS records
     int SBOffset;
+    bool literalPoolON;
+    vector<int> literalSBOffsets;        // SB offset of each DS literal, indexed by its text ID (-1 = not pooled)
+    int pooledLiterals;
+    int pooledLiteralBytesSaved;
+    bool peepholeOptimizerON;
+    long long peepholeHits[PEEPHOLERULES];
+    long long peepholeRemoved;
     int labelsuffix;
     //--------------------------------------------------
     // ADDED FOR SPL6
     //--------------------------------------------------
-    vector<DATARECORD> framedata;
+    vector<INSTRUCTION> framedata;
     int FBOffset;
     bool isInModuleBody;
     int moduleIdentifierIndex;
@@ -839,6 +3014,31 @@ public:
     int LabelSuffix();
     void EmitFormattedLine(const char label[], const char mnemonic[], const char operand[] = "", const char comment[] = "");
     void EmitUnformattedLine(const char line[]);
+    void Flush();
+    void SetStatistics(STATISTICS* statistics)
+    {
+        this->statistics = statistics;
+    }
+    void SetSourceLineNumber(int sourceLineNumber)
+    {
+        this->sourceLineNumber = sourceLineNumber;
+    }
+    const vector<INSTRUCTION>& GetInstructions()
+    {
+        return(this->instructions);
+    }
+    const char* GetText(int text)
+    {
+        return(texts.GetSpelling(text));
+    }
+    const char* GetCodeFileName()
+    {
+        return(this->codeFileName);
+    }
+    long long GetBytesWritten()
+    {
+        return(STM.is_open() ? (long long)STM.tellp() : 0);
+    }
     //--------------------------------------------------
     // ADDED FOR SPL6
     //--------------------------------------------------
@@ -873,16 +3073,135 @@ public:
     {
         return(this->mixedModeON);
     }
+    void SetLiteralPoolON(const bool setting = true)
+    {
+        this->literalPoolON = setting;
+    }
+    int GetPooledLiterals()
+    {
+        return(this->pooledLiterals);
+    }
+    int GetPooledLiteralBytesSaved()
+    {
+        return(this->pooledLiteralBytesSaved);
+    }
+    void SetPeepholeOptimizerON(const bool setting = true)
+    {
+        this->peepholeOptimizerON = setting;
+    }
+    long long GetPeepholeHits(PEEPHOLERULE rule)
+    {
+        return(this->peepholeHits[rule]);
+    }
+    long long GetPeepholeRemoved()
+    {
+        return(this->peepholeRemoved);
+    }
+    static const char* GetPeepholeRuleName(PEEPHOLERULE rule)
+    {
+        return(PEEPHOLEPATTERNS[rule].name);
+    }
 private:
     void EmitCommonSubroutines();
+    int InternText(const char text[])
+    {
+        return((text[0] == '\0') ? 0 : texts.Intern(text, (int)strlen(text)));
+    }
+    int AddComment(const char text[])
+    {
+        return((text[0] == '\0') ? 0 : comments.Append(text, (int)strlen(text)));
+    }
+    static OPCODE FindOpcode(const char mnemonic[]);
+    static bool ParseDecimal(const char digits[], int& value);
+    void ParseOperand(const char operand[], INSTRUCTION& instruction);
+    void MakeInstruction(const char label[], const char mnemonic[], const char operand[], const char comment[], INSTRUCTION& instruction);
+    void EmitInstructions(const vector<INSTRUCTION>& records);
+    bool OptimizePeephole();
+    bool ApplyPeepholeRule(PEEPHOLERULE rule, const int window[]);
+    void RemoveInstruction(int index);
+    const char* FormatOperand(const INSTRUCTION& instruction, int& length);
+    void WriteFormattedLine(const char label[], int labelLength, const char mnemonic[], int mnemonicLength,
+        const char operand[], int operandLength, const char comment[], int commentLength);
+    void WriteBuffer();
+    //--------------------------------------------------
+    void Append(const char characters[], int length)
+    //--------------------------------------------------
+    {
+        if (bufferLength + length > BUFFERSIZE)
+        {
+            WriteBuffer();
+            if (length > BUFFERSIZE)
+            {
+                STM.write(characters, length);
+                return;
+            }
+        }
+        memcpy(&buffer[bufferLength], characters, length);
+        bufferLength += length;
+    }
+    //--------------------------------------------------
+    void AppendField(const char characters[], int length, int width)
+    //--------------------------------------------------
+    {
+        // Same as STM << left << setw(width) << characters
+        Append(characters, length);
+        if (length < width)
+        {
+            if (bufferLength + (width - length) > BUFFERSIZE) WriteBuffer();
+            memset(&buffer[bufferLength], ' ', width - length);
+            bufferLength += width - length;
+        }
+    }
+};
+
+//-----------------------------------------------------------
+const char CODE::MNEMONICS[][7 + 1] =
+//-----------------------------------------------------------
+{
+   "",
+   "ADDI", "AND", "CALL", "CMPI", "DISCARD", "DIVI", "DS", "DW",
+   "EQU", "JMP", "JMPE", "JMPG", "JMPGE", "JMPL", "JMPLE", "JMPNE",
+   "JMPNN", "JMPNT", "JMPT", "MAKEDUP", "MULI", "NAND", "NEGI", "NOR",
+   "NOT", "OR", "ORG", "POP", "POPSB", "POPSP", "POWI", "PUSH",
+   "PUSHA", "REMI", "RETURN", "RW", "SETNZPI", "SETT", "SUBI", "SVC",
+   "SWAP", "XOR",
+   "",
+   ""
+};
+
+//-----------------------------------------------------------
+const CODE::PEEPHOLEPATTERN CODE::PEEPHOLEPATTERNS[PEEPHOLERULES] =
+//-----------------------------------------------------------
+{
+   { "store and discard", 5, { STM_MAKEDUP, STM_POP, STM_SWAP, STM_DISCARD, STM_DISCARD } },
+   { "store to direct address", 4, { STM_PUSHA, STM_PUSH, STM_POP, STM_DISCARD } },
+   { "push and pop same operand", 2, { STM_PUSH, STM_POP } },
+   { "branch if comparison false", 8, { STM_NONE, STM_PUSH, STM_JMP, STM_PUSH, STM_EQU, STM_SETT, STM_DISCARD, STM_JMPNT } },
+   { "branch if comparison true", 8, { STM_NONE, STM_PUSH, STM_JMP, STM_PUSH, STM_EQU, STM_SETT, STM_DISCARD, STM_JMPT } }
 };
 
 //-----------------------------------------------------------
 CODE::CODE()
 //-----------------------------------------------------------
 {
+    codeFileName[0] = '\0';
+    statistics = NULL;
+    sourceLineNumber = 0;
+    buffer = new char[BUFFERSIZE];
+    bufferLength = 0;
     staticdata.clear();
     SBOffset = 0;
+    literalPoolON = false;
+    pooledLiterals = 0;
+    pooledLiteralBytesSaved = 0;
+#ifdef PEEPHOLEOPTIMIZER
+    peepholeOptimizerON = true;
+#else
+    peepholeOptimizerON = false;
+#endif
+    for (int rule = 0; rule <= PEEPHOLERULES - 1; rule++)
+        peepholeHits[rule] = 0;
+    peepholeRemoved = 0;
     labelsuffix = 0;
     //--------------------------------------------------
     // ADDED FOR SPL6
@@ -904,9 +3223,11 @@ CODE::~CODE()
 {
     if (STM.is_open())
     {
+        Flush();
         STM.flush();
         STM.close();
     }
+    delete[] buffer;
 }
 
 //--------------------------------------------------
@@ -1035,6 +3356,22 @@ void CODE::EmitEndingCode()
     EmitUnformattedLine(";------------------------------------------------------------");
     EmitFormattedLine("STATICDATA", "EQU", "*");
     EmitStaticData();
+    if (pooledLiterals > 0)
+    {
+        // (one STM word is 2 bytes)
+        sprintf(reference, "; %d duplicate string literals pooled (%d bytes saved)", pooledLiterals, pooledLiteralBytesSaved);
+        EmitUnformattedLine(reference);
+    }
+    if (peepholeRemoved > 0)
+    {
+        for (int rule = 0; rule <= PEEPHOLERULES - 1; rule++)
+        {
+            sprintf(reference, "; peephole rule \"%s\" applied %lld times", PEEPHOLEPATTERNS[rule].name, peepholeHits[rule]);
+            EmitUnformattedLine(reference);
+        }
+        sprintf(reference, "; %lld instructions removed by the peephole optimizer", peepholeRemoved);
+        EmitUnformattedLine(reference);
+    }
 
     EmitUnformattedLine(";------------------------------------------------------------");
     EmitUnformattedLine("; Heap space for dynamic memory allocation (to support future AGL syntax)");
@@ -1046,6 +3383,8 @@ void CODE::EmitEndingCode()
     EmitUnformattedLine("; Run-time stack");
     EmitUnformattedLine(";------------------------------------------------------------");
     EmitFormattedLine("RUNTIMESTACK", "EQU", "0XFFFE");
+
+    Flush();
 }
 
 //--------------------------------------------------
@@ -1059,12 +3398,16 @@ int CODE::GetSBOffset()
 void CODE::AddRWToStaticData(int operand, const char comment[], char reference[])
 //--------------------------------------------------
 {
-    DATARECORD r;
-
-    strcpy(r.mnemonic, "RW");
-    sprintf(r.operand, "0D%d", operand);
-    strcpy(r.comment, comment);
+    INSTRUCTION r;
+
+    r.opcode = STM_RW;
+    r.operandKind = CONSTANTOPERAND;
+    r.operand = operand;
+    r.label = 0;
+    r.comment = AddComment(comment);
+    r.sourceLineNumber = 0;
     staticdata.push_back(r);
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::STATICDATARECORDS);
     sprintf(reference, "SB:0D%d", SBOffset);
     SBOffset += operand;
 }
@@ -1073,12 +3416,11 @@ void CODE::AddRWToStaticData(int operand, const char comment[], char reference[]
 void CODE::AddDWToStaticData(const char operand[], const char comment[], char reference[])
 //--------------------------------------------------
 {
-    DATARECORD r;
+    INSTRUCTION r;
 
-    strcpy(r.mnemonic, "DW");
-    strcpy(r.operand, operand);
-    strcpy(r.comment, comment);
+    MakeInstruction("", "DW", operand, comment, r);
     staticdata.push_back(r);
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::STATICDATARECORDS);
     sprintf(reference, "SB:0D%d", SBOffset);
     SBOffset += 1;
 }
@@ -1086,27 +3428,72 @@ void CODE::AddDWToStaticData(const char operand[], const char comment[], char re
 void CODE::AddDSToStaticData(const char operand[], const char comment[], char reference[])
 //--------------------------------------------------
 {
-    DATARECORD r;
+    INSTRUCTION r;
+    const int length = (int)strlen(operand);
 
     /*
        An STM <string> must be "-delimited and have *all* embedded " \-escaped. For examples
-          operand = "abc\" should yield r.operand = "\"abc\""
-          operand = abc"xyz should yield r.operand = "abc\"xyz"
+          operand = "abc\" should yield the STM operand "\"abc\""
+          operand = abc"xyz should yield the STM operand "abc\"xyz"
+       The characters between the quotes are interned in texts (ID 0 is "").
+    */
+    r.opcode = STM_DS;
+    r.operandKind = STRINGOPERAND;
+    r.operand = (length == 0) ? 0 : texts.Intern(operand, length);
+
+    /*
+       With the literal pool ON a literal already in static data is not added again;
+          interning has already hashed it to its text ID, which indexes the pool.
+          (DS literals are only ever written, never modified, by the code AGL emits.)
+          Only whole literals are shared: an STM string is preceded by its own
+          capacity and length words, so one cannot be a suffix of another.
     */
-    strcpy(r.mnemonic, "DS");
-    sprintf(r.operand, "\"%s\"", operand);
-    strcpy(r.comment, comment);
+    if (literalPoolON)
+    {
+        if ((r.operand <= (int)literalSBOffsets.size() - 1) && (literalSBOffsets[r.operand] >= 0))
+        {
+            pooledLiterals++;
+            pooledLiteralBytesSaved += 2 * (2 + length);
+            if ((statistics != NULL) && statistics->IsON())
+            {
+                statistics->Count(STATISTICS::POOLEDLITERALS);
+                statistics->Count(STATISTICS::LITERALPOOLBYTESSAVED, 2 * (2 + length));
+            }
+            sprintf(reference, "SB:0D%d", literalSBOffsets[r.operand]);
+            return;
+        }
+        if (r.operand >= (int)literalSBOffsets.size()) literalSBOffsets.resize(r.operand + 1, -1);
+        literalSBOffsets[r.operand] = SBOffset;
+    }
+    r.label = 0;
+    r.comment = AddComment(comment);
+    r.sourceLineNumber = 0;
     staticdata.push_back(r);
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::STATICDATARECORDS);
     sprintf(reference, "SB:0D%d", SBOffset);
-    SBOffset += 2 + (int)strlen(operand);
+    SBOffset += 2 + length;
 }
 
 //--------------------------------------------------
 void CODE::EmitStaticData()
 //--------------------------------------------------
 {
-    for (int i = 0; i <= (int)staticdata.size() - 1; i++)
-        EmitFormattedLine("", staticdata[i].mnemonic, staticdata[i].operand, staticdata[i].comment);
+    EmitInstructions(staticdata);
+}
+
+//--------------------------------------------------
+void CODE::EmitInstructions(const vector<INSTRUCTION>& records)
+//--------------------------------------------------
+{
+    // Emit static data or frame data records as if by EmitFormattedLine()
+    STATISTICS::TIMER timer(statistics, STATISTICS::CODEPHASE);
+
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::INSTRUCTIONS, (long long)records.size());
+    for (int i = 0; i <= (int)records.size() - 1; i++)
+    {
+        instructions.push_back(records[i]);
+        instructions.back().sourceLineNumber = sourceLineNumber;
+    }
 }
 
 //--------------------------------------------------
@@ -1120,27 +3507,479 @@ int CODE::LabelSuffix()
 //--------------------------------------------------
 void CODE::EmitFormattedLine(const char label[], const char mnemonic[], const char operand[], const char comment[])
 //--------------------------------------------------
+{
+    STATISTICS::TIMER timer(statistics, STATISTICS::CODEPHASE);
+    INSTRUCTION instruction;
+
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::INSTRUCTIONS);
+    MakeInstruction(label, mnemonic, operand, comment, instruction);
+    instructions.push_back(instruction);
+    if (peepholeOptimizerON)
+        while (OptimizePeephole());
+}
+
+//--------------------------------------------------
+void CODE::MakeInstruction(const char label[], const char mnemonic[], const char operand[], const char comment[], INSTRUCTION& instruction)
+//--------------------------------------------------
+{
+    if ((mnemonic[0] == ';') && (operand[0] == '\0') && (comment[0] == '\0'))
+    {
+        instruction.opcode = STM_COMMENTLINE;
+        ParseOperand("", instruction);
+        instruction.comment = AddComment(mnemonic);
+    }
+    else
+    {
+        instruction.opcode = (unsigned char)FindOpcode(mnemonic);
+        ParseOperand(operand, instruction);
+        instruction.comment = AddComment(comment);
+    }
+    instruction.label = InternText(label);
+    instruction.sourceLineNumber = sourceLineNumber;
+}
+
+//--------------------------------------------------
+void CODE::EmitUnformattedLine(const char line[])
+//--------------------------------------------------
+{
+    STATISTICS::TIMER timer(statistics, STATISTICS::CODEPHASE);
+    INSTRUCTION instruction;
+
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::UNFORMATTEDLINES);
+    instruction.opcode = STM_UNFORMATTEDLINE;
+    instruction.operandKind = NOOPERAND;
+    instruction.operand = 0;
+    instruction.label = 0;
+    instruction.comment = AddComment(line);
+    instruction.sourceLineNumber = sourceLineNumber;
+    instructions.push_back(instruction);
+}
+
+//--------------------------------------------------
+void CODE::Flush()
+//--------------------------------------------------
+{
+    // Write (and forget) every instruction emitted so far
+    STATISTICS::TIMER timer(statistics, STATISTICS::CODEPHASE);
+
+    for (int i = 0; i <= (int)instructions.size() - 1; i++)
+    {
+        const INSTRUCTION& instruction = instructions[i];
+
+        if (instruction.opcode == STM_UNFORMATTEDLINE)
+        {
+            Append(comments.GetText(instruction.comment), comments.GetLength(instruction.comment));
+            Append("\n", 1);
+        }
+        else if (instruction.opcode == STM_COMMENTLINE)
+            WriteFormattedLine(texts.GetSpelling(instruction.label), texts.GetLength(instruction.label),
+                comments.GetText(instruction.comment), comments.GetLength(instruction.comment), "", 0, "", 0);
+        else
+        {
+            const char* operand;
+            int operandLength;
+
+            operand = FormatOperand(instruction, operandLength);
+            WriteFormattedLine(texts.GetSpelling(instruction.label), texts.GetLength(instruction.label),
+                MNEMONICS[instruction.opcode], (int)strlen(MNEMONICS[instruction.opcode]),
+                operand, operandLength, comments.GetText(instruction.comment), comments.GetLength(instruction.comment));
+        }
+    }
+    instructions.clear();
+    WriteBuffer();
+}
+
+//--------------------------------------------------
+void CODE::WriteBuffer()
+//--------------------------------------------------
+{
+    if (bufferLength > 0)
+    {
+        STM.write(buffer, bufferLength);
+        bufferLength = 0;
+    }
+    STM.flush();
+}
+
+//--------------------------------------------------
+CODE::OPCODE CODE::FindOpcode(const char mnemonic[])
+//--------------------------------------------------
+{
+    // Binary search of MNEMONICS[STM_ADDI..STM_XOR]
+    int low = STM_ADDI, high = STM_XOR;
+
+    if (mnemonic[0] == '\0') return(STM_NONE);
+    while (low <= high)
+    {
+        const int middle = (low + high) / 2;
+        const int comparison = strcmp(mnemonic, MNEMONICS[middle]);
+
+        if (comparison == 0)
+            return((OPCODE)middle);
+        else if (comparison < 0)
+            high = middle - 1;
+        else
+            low = middle + 1;
+    }
+    throw(AGLEXCEPTION("Unknown STM mnemonic"));
+}
+
+//--------------------------------------------------
+bool CODE::ParseDecimal(const char digits[], int& value)
+//--------------------------------------------------
+{
+    /*
+       Only the digits "0D%d" formats (an optional '-', no leading zeros, at most 9
+          digits) so the operand is written back exactly as it was emitted
+    */
+    int i = (digits[0] == '-') ? 1 : 0;
+    int n = 0;
+
+    if ((digits[i] == '0') && (digits[i + 1] != '\0')) return(false);
+    value = 0;
+    while (isdigit(digits[i + n]) && (n <= 9 - 1))
+    {
+        value = 10 * value + (digits[i + n] - '0');
+        n++;
+    }
+    if ((n == 0) || (digits[i + n] != '\0')) return(false);
+    if ((i == 1) && (value == 0)) return(false);
+    if (i == 1) value = -value;
+    return(true);
+}
+
+//--------------------------------------------------
+void CODE::ParseOperand(const char operand[], INSTRUCTION& instruction)
+//--------------------------------------------------
+{
+    /*
+       Operands that do not have exactly one of the typed forms (for example,
+          #0X1 or 0B0001000000000000) are kept as TEXTOPERAND
+    */
+    const int length = (int)strlen(operand);
+    int value;
+
+    instruction.operand = 0;
+    if (length == 0)
+        instruction.operandKind = NOOPERAND;
+    else if ((strncmp(operand, "#0D", 3) == 0) && ParseDecimal(&operand[3], value))
+    {
+        instruction.operandKind = IMMEDIATEOPERAND;
+        instruction.operand = value;
+    }
+    else if ((length == 7) && (strncmp(operand, "#0X", 3) == 0) && (strspn(&operand[3], "0123456789ABCDEF") == 4))
+    {
+        instruction.operandKind = HEXIMMEDIATEOPERAND;
+        instruction.operand = (int)strtol(&operand[3], NULL, 16);
+    }
+    else if ((operand[0] == '#') && (isalpha(operand[1]) || (operand[1] == '_'))
+        && (strspn(&operand[1], "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_") == (size_t)(length - 1)))
+    {
+        instruction.operandKind = SYMBOLIMMEDIATEOPERAND;
+        instruction.operand = InternText(&operand[1]);
+    }
+    else if ((strncmp(operand, "0D", 2) == 0) && ParseDecimal(&operand[2], value))
+    {
+        instruction.operandKind = CONSTANTOPERAND;
+        instruction.operand = value;
+    }
+    else if ((strncmp(operand, "SB:0D", 5) == 0) && ParseDecimal(&operand[5], value))
+    {
+        instruction.operandKind = SBOPERAND;
+        instruction.operand = value;
+    }
+    else if ((strncmp(operand, "FB:0D", 5) == 0) && ParseDecimal(&operand[5], value))
+    {
+        instruction.operandKind = FBOPERAND;
+        instruction.operand = value;
+    }
+    else if ((strncmp(operand, "SP:0D", 5) == 0) && ParseDecimal(&operand[5], value))
+    {
+        instruction.operandKind = SPOPERAND;
+        instruction.operand = value;
+    }
+    else if ((strncmp(operand, "@SP:0D", 6) == 0) && ParseDecimal(&operand[6], value))
+    {
+        instruction.operandKind = INDIRECTSPOPERAND;
+        instruction.operand = value;
+    }
+    else if ((isalpha(operand[0]) || (operand[0] == '_'))
+        && (strspn(operand, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_") == (size_t)length))
+    {
+        instruction.operandKind = LABELOPERAND;
+        instruction.operand = InternText(operand);
+    }
+    else if (strcmp(operand, "*") == 0)
+        instruction.operandKind = LOCATIONOPERAND;
+    else if ((length >= 2) && (operand[0] == '"') && (operand[length - 1] == '"'))
+    {
+        instruction.operandKind = STRINGOPERAND;
+        instruction.operand = (length == 2) ? 0 : texts.Intern(&operand[1], length - 2);
+    }
+    else
+    {
+        instruction.operandKind = TEXTOPERAND;
+        instruction.operand = InternText(operand);
+    }
+}
+
+//--------------------------------------------------
+const char* CODE::FormatOperand(const INSTRUCTION& instruction, int& length)
+//--------------------------------------------------
+{
+    // The operand exactly as it was emitted (the text is valid until the next call)
+    static const char PREFIXES[][6 + 1] = { "", "#0D", "#0X", "#", "0D", "SB:0D", "FB:0D", "SP:0D", "@SP:0D" };
+    static const char HEXDIGITS[] = "0123456789ABCDEF";
+    const int kind = instruction.operandKind;
+    char digits[11 + 1];
+    int n = 0;
+
+    switch (kind)
+    {
+    case NOOPERAND:
+        length = 0;
+        return("");
+    case LOCATIONOPERAND:
+        length = 1;
+        return("*");
+    case LABELOPERAND:
+    case TEXTOPERAND:
+        length = texts.GetLength(instruction.operand);
+        return(texts.GetSpelling(instruction.operand));
+    case SYMBOLIMMEDIATEOPERAND:
+    case STRINGOPERAND:
+        operandText.assign((kind == STRINGOPERAND) ? "\"" : "#");
+        operandText.append(texts.GetSpelling(instruction.operand), texts.GetLength(instruction.operand));
+        if (kind == STRINGOPERAND) operandText.append("\"");
+        length = (int)operandText.size();
+        return(operandText.c_str());
+    case HEXIMMEDIATEOPERAND:
+    {
+        // Same as "#0X%04X"
+        unsigned int value = (unsigned int)instruction.operand;
+        int k = 3;
+
+        while ((k <= 6) && ((value >> (4 * (k + 1))) != 0)) k++;
+        for (; k >= 0; k--)
+            digits[n++] = HEXDIGITS[(value >> (4 * k)) & 0XF];
+        break;
+    }
+    default:
+    {
+        // Same as "%d"
+        unsigned int magnitude = (instruction.operand < 0) ? 0U - (unsigned int)instruction.operand : (unsigned int)instruction.operand;
+
+        do
+        {
+            digits[sizeof(digits) - 1 - n++] = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (instruction.operand < 0) digits[sizeof(digits) - 1 - n++] = '-';
+        memmove(digits, &digits[sizeof(digits) - n], n);
+        break;
+    }
+    }
+    operandText.assign(PREFIXES[kind]);
+    operandText.append(digits, n);
+    length = (int)operandText.size();
+    return(operandText.c_str());
+}
+
+//--------------------------------------------------
+void CODE::WriteFormattedLine(const char label[], int labelLength, const char mnemonic[], int mnemonicLength,
+    const char operand[], int operandLength, const char comment[], int commentLength)
+//--------------------------------------------------
 {
     /*
              1         2         3         4         5         6         7         8
     ^234567890123456789012 ^56789012 ^5678901234567890123 ^6789012345678901234567890
 
     ^ is a pre-established Dr. Hanna tab stop
-    */
-    char line[110 + 1];
 
-    if ((int)strlen(comment) > 0)
-        sprintf(line, "%-22s %-9s %-20s ; %s", label, mnemonic, operand, comment);
+       Same as sprintf("%-22s %-9s %-20s ; %s") (or "%-22s %-9s %s" without a comment);
+          a field longer than its column pushes the rest of the line right.
+    */
+    AppendField(label, labelLength, 22);
+    Append(" ", 1);
+    AppendField(mnemonic, mnemonicLength, 9);
+    Append(" ", 1);
+    if (commentLength > 0)
+    {
+        AppendField(operand, operandLength, 20);
+        Append(" ; ", 3);
+        Append(comment, commentLength);
+    }
     else
-        sprintf(line, "%-22s %-9s %s", label, mnemonic, operand);
-    STM << line << endl;
+        Append(operand, operandLength);
+    Append("\n", 1);
 }
 
 //--------------------------------------------------
-void CODE::EmitUnformattedLine(const char line[])
+bool CODE::OptimizePeephole()
+//--------------------------------------------------
+{
+    /*
+       Try each rule whose pattern ends with the instruction just emitted. window[]
+          gets the indexes of the last pattern-length instructions, oldest first,
+          skipping comment lines (which are neither matched nor removed).
+    */
+    const unsigned char opcode = instructions.back().opcode;
+
+    for (int rule = 0; rule <= PEEPHOLERULES - 1; rule++)
+    {
+        const PEEPHOLEPATTERN& pattern = PEEPHOLEPATTERNS[rule];
+        int window[MAXIMUMPEEPHOLELENGTH];
+        int n = pattern.length;
+        bool isMatched = true;
+
+        if (pattern.opcodes[pattern.length - 1] != opcode) continue;
+        for (int i = (int)instructions.size() - 1; (i >= 0) && (n > 0); i--)
+        {
+            if ((instructions[i].opcode == STM_COMMENTLINE) || (instructions[i].opcode == STM_UNFORMATTEDLINE)) continue;
+            window[--n] = i;
+        }
+        if (n > 0) continue;
+        for (int k = 0; (k <= pattern.length - 1) && isMatched; k++)
+            isMatched = (pattern.opcodes[k] == STM_NONE) || (instructions[window[k]].opcode == pattern.opcodes[k]);
+        if (!isMatched || !ApplyPeepholeRule((PEEPHOLERULE)rule, window)) continue;
+
+        // Close up the instructions RemoveInstruction() marked STM_NONE
+        int removed = 0;
+
+        for (int i = window[0]; i <= (int)instructions.size() - 1; i++)
+        {
+            if (instructions[i].opcode == STM_NONE)
+                removed++;
+            else if (removed > 0)
+                instructions[i - removed] = instructions[i];
+        }
+        instructions.resize(instructions.size() - removed);
+        peepholeHits[rule]++;
+        if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::PEEPHOLEHITS);
+        return(true);
+    }
+    return(false);
+}
+
+//--------------------------------------------------
+bool CODE::ApplyPeepholeRule(PEEPHOLERULE rule, const int window[])
+//--------------------------------------------------
+{
+    /*
+       Check the operands and labels the pattern does not, then rewrite. Only the
+          first instruction of a window may be the target of a jump from outside it,
+          so every other instruction must be unlabeled unless the rule says otherwise.
+    */
+    INSTRUCTION* w[MAXIMUMPEEPHOLELENGTH];
+
+    for (int k = 0; k <= PEEPHOLEPATTERNS[rule].length - 1; k++)
+        w[k] = &instructions[window[k]];
+    switch (rule)
+    {
+    case STOREANDDISCARDRULE:
+        // Store the value on top into the address below it, then discard both
+        //    (the same as the INVOKE statement's POP @SP:0D1; DISCARD #0D1)
+        if ((w[1]->operandKind != INDIRECTSPOPERAND) || (w[1]->operand != 2)
+            || (w[3]->operandKind != IMMEDIATEOPERAND) || (w[3]->operand != 1)
+            || (w[4]->operandKind != IMMEDIATEOPERAND) || (w[4]->operand != 1)
+            || (w[1]->label != 0) || (w[2]->label != 0) || (w[3]->label != 0) || (w[4]->label != 0))
+            return(false);
+        w[0]->opcode = STM_POP;
+        w[0]->operandKind = INDIRECTSPOPERAND;
+        w[0]->operand = 1;
+        w[1]->opcode = STM_DISCARD;
+        w[1]->operandKind = IMMEDIATEOPERAND;
+        w[1]->operand = 1;
+        RemoveInstruction(window[2]);
+        RemoveInstruction(window[3]);
+        RemoveInstruction(window[4]);
+        return(true);
+    case STOREDIRECTRULE:
+        // Store a value that takes one PUSH straight into the address (y must not be
+        //    SP-relative: without x on the stack its offset would change)
+        if ((w[2]->operandKind != INDIRECTSPOPERAND) || (w[2]->operand != 1)
+            || (w[3]->operandKind != IMMEDIATEOPERAND) || (w[3]->operand != 1)
+            || (w[1]->label != 0) || (w[2]->label != 0) || (w[3]->label != 0)
+            || ((w[0]->operandKind != SBOPERAND) && (w[0]->operandKind != FBOPERAND) && (w[0]->operandKind != LABELOPERAND))
+            || ((w[1]->operandKind != IMMEDIATEOPERAND) && (w[1]->operandKind != HEXIMMEDIATEOPERAND)
+                && (w[1]->operandKind != SYMBOLIMMEDIATEOPERAND) && (w[1]->operandKind != SBOPERAND)
+                && (w[1]->operandKind != FBOPERAND) && (w[1]->operandKind != LABELOPERAND)))
+            return(false);
+        w[2]->opcode = STM_POP;
+        w[2]->operandKind = w[0]->operandKind;
+        w[2]->operand = w[0]->operand;
+        w[0]->opcode = STM_PUSH;
+        w[0]->operandKind = w[1]->operandKind;
+        w[0]->operand = w[1]->operand;
+        RemoveInstruction(window[1]);
+        RemoveInstruction(window[3]);
+        return(true);
+    case PUSHPOPRULE:
+        // Storing a variable's own value back into it does nothing
+        if ((w[0]->operandKind != w[1]->operandKind) || (w[0]->operand != w[1]->operand) || (w[1]->label != 0)
+            || ((w[0]->operandKind != SBOPERAND) && (w[0]->operandKind != FBOPERAND) && (w[0]->operandKind != LABELOPERAND)))
+            return(false);
+        RemoveInstruction(window[0]);
+        RemoveInstruction(window[1]);
+        return(true);
+    case BRANCHIFFALSERULE:
+    case BRANCHIFTRUERULE:
+    {
+        /*
+           A comparison materialized as #0XFFFF/#0X0000 and immediately tested is
+              replaced by a jump on the comparison's own condition (negated for JMPNT).
+              T and E are left as "EQU *".
+        */
+        static const unsigned char CONDITIONS[][2] =
+        {
+            { STM_JMPL, STM_JMPGE }, { STM_JMPLE, STM_JMPG }, { STM_JMPE, STM_JMPNE },
+            { STM_JMPNE, STM_JMPE }, { STM_JMPG, STM_JMPLE }, { STM_JMPGE, STM_JMPL }
+        };
+        int condition = -1;
+
+        for (int i = 0; i <= (int)(sizeof(CONDITIONS) / sizeof(CONDITIONS[0])) - 1; i++)
+            if (w[0]->opcode == CONDITIONS[i][0]) condition = i;
+        if ((condition == -1) || (w[0]->operandKind != LABELOPERAND)
+            || (w[1]->operandKind != HEXIMMEDIATEOPERAND) || (w[1]->operand != 0X0000) || (w[1]->label != 0)
+            || (w[2]->operandKind != LABELOPERAND) || (w[2]->label != 0)
+            || (w[3]->operandKind != HEXIMMEDIATEOPERAND) || (w[3]->operand != 0XFFFF) || (w[3]->label != w[0]->operand)
+            || (w[4]->operandKind != LOCATIONOPERAND) || (w[4]->label != w[2]->operand)
+            || (w[5]->label != 0)
+            || (w[6]->operandKind != IMMEDIATEOPERAND) || (w[6]->operand != 1) || (w[6]->label != 0)
+            || (w[7]->operandKind != LABELOPERAND) || (w[7]->label != 0))
+            return(false);
+        w[0]->opcode = CONDITIONS[condition][(rule == BRANCHIFFALSERULE) ? 1 : 0];
+        w[0]->operand = w[7]->operand;
+        RemoveInstruction(window[1]);
+        RemoveInstruction(window[2]);
+        RemoveInstruction(window[3]);
+        RemoveInstruction(window[5]);
+        RemoveInstruction(window[6]);
+        RemoveInstruction(window[7]);
+        return(true);
+    }
+    default:
+        return(false);
+    }
+}
+
+//--------------------------------------------------
+void CODE::RemoveInstruction(int index)
 //--------------------------------------------------
 {
-    STM << line << endl;
+    // Mark for OptimizePeephole() to close up (a label definition stays, as EQU *)
+    INSTRUCTION& instruction = instructions[index];
+
+    if (instruction.label != 0)
+    {
+        instruction.opcode = STM_EQU;
+        instruction.operandKind = LOCATIONOPERAND;
+        instruction.operand = 0;
+    }
+    else
+        instruction.opcode = STM_NONE;
+    peepholeRemoved++;
+    if ((statistics != NULL) && statistics->IsON()) statistics->Count(STATISTICS::PEEPHOLEREMOVED);
 }
 
 //--------------------------------------------------
@@ -1169,11 +4008,9 @@ int CODE::GetFBOffset()
 void CODE::AddInstructionToInitializeFrameData(const char mnemonic[], const char operand[], const char comment[])
 //--------------------------------------------------
 {
-    DATARECORD r;
+    INSTRUCTION r;
 
-    strcpy(r.mnemonic, mnemonic);
-    strcpy(r.operand, operand);
-    strcpy(r.comment, comment);
+    MakeInstruction("", mnemonic, operand, comment, r);
     framedata.push_back(r);
 }
 
@@ -1181,8 +4018,7 @@ void CODE::AddInstructionToInitializeFrameData(const char mnemonic[], const char
 void CODE::EmitFrameData()
 //--------------------------------------------------
 {
-    for (int i = 0; i <= (int)framedata.size() - 1; i++)
-        EmitFormattedLine("", framedata[i].mnemonic, framedata[i].operand, framedata[i].comment);
+    EmitInstructions(framedata);
 }
 
 //--------------------------------------------------